@@ -0,0 +1,144 @@
+// This file is part of lume, a C++ library for lightweight unstructured meshes
+//
+// Copyright (C) 2018 Sebastian Reiter
+// Copyright (C) 2018 G-CSC, Goethe University Frankfurt
+// Author: Sebastian Reiter <s.b.reiter@gmail.com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+//	Compares GrobHashMap with the previously used std::unordered_map.
+//
+//	All faces of all cells of a hexahedral grid are inserted into both
+//	containers and are looked up again afterwards. The previous container used
+//	a weak hash (a sum of squared corners) and an order independent, quadratic
+//	`Grob::operator ==`. Both are reproduced here as `LegacyHash` and
+//	`LegacyEqual`.
+//
+//	usage: lume_grob_hash_bench [grid resolution] [skip legacy (0/1)]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+#include "lume/grob_hash.h"
+#include "lume/mesh.h"
+
+using namespace std;
+using namespace lume;
+
+static double Seconds (const chrono::steady_clock::time_point& start)
+{
+	return chrono::duration <double> (chrono::steady_clock::now() - start).count();
+}
+
+struct LegacyHash {
+	size_t operator () (const Grob& grob) const
+	{
+		const index_t numCorners = grob.num_corners();
+		size_t h = 0;
+		for(index_t i = 0; i < numCorners; ++i){
+			const index_t c = grob.corner(i);
+			h += c * c;
+		}
+		return 10^8 * (grob.grob_type() + 1) + h;
+	}
+};
+
+struct LegacyEqual {
+	bool operator () (const Grob& g0, const Grob& g1) const	{return g0 == g1;}
+};
+
+/// creates the corners of a grid of `n^3` hexahedra
+static vector <index_t> CreateHexGridCorners (const index_t n)
+{
+	vector <index_t> corners;
+	corners.reserve (size_t (n) * n * n * 8);
+	auto vrt = [n] (index_t x, index_t y, index_t z) {return (z * (n + 1) + y) * (n + 1) + x;};
+	for(index_t z = 0; z < n; ++z) {
+		for(index_t y = 0; y < n; ++y) {
+			for(index_t x = 0; x < n; ++x) {
+				const index_t hex[] = {vrt (x, y, z), vrt (x + 1, y, z),
+				                       vrt (x + 1, y + 1, z), vrt (x, y + 1, z),
+				                       vrt (x, y, z + 1), vrt (x + 1, y, z + 1),
+				                       vrt (x + 1, y + 1, z + 1), vrt (x, y + 1, z + 1)};
+				corners.insert (corners.end(), hex, hex + 8);
+			}
+		}
+	}
+	return corners;
+}
+
+/// inserts all faces of all hexahedra and looks them up again
+/** Each new face receives the number of faces inserted before it as value.
+ * \returns	the sum of all values found during look-up.*/
+template <class TMap>
+static uint64_t Run (TMap& map, const vector <index_t>& corners, const char* name)
+{
+	const size_t numHexes = corners.size() / 8;
+
+	auto start = chrono::steady_clock::now ();
+	index_t numFaces = 0;
+	for(size_t i = 0; i < numHexes; ++i) {
+		const Grob hex (HEX, corners.data() + i * 8);
+		for(index_t j = 0; j < hex.num_sides (2); ++j) {
+			if (map.insert (make_pair (hex.side (2, j), numFaces)).second)
+				++numFaces;
+		}
+	}
+	const double insertTime = Seconds (start);
+
+	start = chrono::steady_clock::now ();
+	uint64_t sum = 0;
+	for(size_t i = 0; i < numHexes; ++i) {
+		const Grob hex (HEX, corners.data() + i * 8);
+		for(index_t j = 0; j < hex.num_sides (2); ++j)
+			sum += (*map.find (hex.side (2, j))).second;
+	}
+	const double findTime = Seconds (start);
+
+	cout << name << ": " << numFaces << " faces, insert " << insertTime
+	     << " s, find " << findTime << " s" << endl;
+	return sum;
+}
+
+int main (int argc, char** argv)
+{
+	const index_t n = argc > 1 ? index_t (atoi (argv [1])) : 60;
+	const bool skipLegacy = argc > 2 && atoi (argv [2]) != 0;
+
+	const vector <index_t> corners = CreateHexGridCorners (n);
+	cout << "hexahedra: " << corners.size() / 8 << ", face occurrences: "
+	     << corners.size() / 8 * 6 << endl;
+
+	GrobHashMap <index_t> grobHashMap;
+	const uint64_t sum = Run (grobHashMap, corners, "GrobHashMap   ");
+
+	if (!skipLegacy) {
+		unordered_map <Grob, index_t, LegacyHash, LegacyEqual> legacyMap;
+		if (Run (legacyMap, corners, "unordered_map ") != sum) {
+			cout << "check FAILED: the containers found different faces" << endl;
+			return 1;
+		}
+		cout << "check passed" << endl;
+	}
+	return 0;
+}
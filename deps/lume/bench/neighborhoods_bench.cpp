@@ -0,0 +1,282 @@
+// This file is part of lume, a C++ library for lightweight unstructured meshes
+//
+// Copyright (C) 2018 Sebastian Reiter
+// Copyright (C) 2018 G-CSC, Goethe University Frankfurt
+// Author: Sebastian Reiter <s.b.reiter@gmail.com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+//	Checks and times incremental updates of Neighborhoods.
+//
+//	Repeatedly removes a batch of random cells from a volume mesh and appends
+//	them again. The neighborhoods between faces and cells are updated through
+//	`Neighborhoods::insert` and `Neighborhoods::erase` and are compared with
+//	freshly refreshed neighborhoods after each step and after `compact`.
+//
+//	usage: lume_neighborhoods_bench [mesh file | grid resolution] [num rounds] [cells per round]
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "lume/file_io.h"
+#include "lume/grob_hash.h"
+#include "lume/neighborhoods.h"
+#include "lume/topology.h"
+
+using namespace std;
+using namespace lume;
+
+using links_t = vector <pair <GrobIndex, GrobIndex>>;
+
+static double Seconds (const chrono::steady_clock::time_point& start)
+{
+	return chrono::duration <double> (chrono::steady_clock::now() - start).count();
+}
+
+/// creates a grid of `n^3` hexahedra
+static SPMesh CreateHexGrid (const index_t n)
+{
+	auto mesh = make_shared <Mesh> ();
+	auto& coords = *mesh->coords ();
+	coords.set_tuple_size (3);
+	for(index_t z = 0; z <= n; ++z) {
+		for(index_t y = 0; y <= n; ++y) {
+			for(index_t x = 0; x <= n; ++x) {
+				coords.push_back (real_t (x));
+				coords.push_back (real_t (y));
+				coords.push_back (real_t (z));
+			}
+		}
+	}
+
+	auto vrt = [n] (index_t x, index_t y, index_t z) {return (z * (n + 1) + y) * (n + 1) + x;};
+	for(index_t z = 0; z < n; ++z) {
+		for(index_t y = 0; y < n; ++y) {
+			for(index_t x = 0; x < n; ++x) {
+				const index_t corners[] = {vrt (x, y, z), vrt (x + 1, y, z),
+				                           vrt (x + 1, y + 1, z), vrt (x, y + 1, z),
+				                           vrt (x, y, z + 1), vrt (x + 1, y, z + 1),
+				                           vrt (x + 1, y + 1, z + 1), vrt (x, y + 1, z + 1)};
+				mesh->insert (Grob (HEX, corners));
+			}
+		}
+	}
+	return mesh;
+}
+
+/// appends the links between the given cell and its faces
+static void CollectFaceLinks (links_t& linksOut,
+                              const Mesh& mesh,
+                              const GrobHashMap <GrobIndex>& faces,
+                              const GrobIndex& cell)
+{
+	const Grob grob = mesh.grob (cell);
+	for(index_t i = 0; i < grob.num_sides (2); ++i)
+		linksOut.push_back (make_pair (faces.at (grob.side (2, i)), cell));
+}
+
+/// removes the given cells of one type from the mesh and updates `nbrhds` incrementally
+/** Cell indices have to stay consecutive. Each removed cell which isn't at the
+ * end of the grob array is thus replaced by a remaining cell from the end of
+ * the array. The links of removed and of moved cells are erased while the mesh
+ * still holds them. After the mesh was updated, the moved cells are inserted
+ * with their new indices.*/
+static void RemoveCells (Mesh& mesh,
+                         Neighborhoods& nbrhds,
+                         const GrobHashMap <GrobIndex>& faces,
+                         const grob_t cellType,
+                         vector <index_t> cells)
+{
+	sort (cells.begin(), cells.end());
+	cells.erase (unique (cells.begin(), cells.end()), cells.end());
+
+	const index_t oldNum = mesh.num (cellType);
+	const index_t newNum = oldNum - index_t (cells.size());
+
+	vector <index_t> holes;
+	for(auto c : cells) {
+		if (c < newNum)
+			holes.push_back (c);
+	}
+
+	vector <index_t> movers;
+	for(index_t c = newNum, i = 0; c < oldNum; ++c) {
+		while (i < cells.size() && cells [i] < c)
+			++i;
+		if (i == cells.size() || cells [i] != c)
+			movers.push_back (c);
+	}
+
+	links_t links;
+	for(auto c : cells)
+		CollectFaceLinks (links, mesh, faces, GrobIndex (cellType, c));
+	for(auto c : movers)
+		CollectFaceLinks (links, mesh, faces, GrobIndex (cellType, c));
+	nbrhds.erase (links);
+
+	GrobArray& grobs = mesh.grobs (cellType);
+	const index_t numCorners = GrobDesc (cellType).num_corners ();
+	index_t* corners = grobs.raw_ptr ();
+	for(size_t i = 0; i < holes.size(); ++i) {
+		copy (corners + movers [i] * numCorners, corners + (movers [i] + 1) * numCorners,
+		      corners + holes [i] * numCorners);
+	}
+	grobs.resize (newNum);
+
+	links.clear ();
+	for(auto c : holes)
+		CollectFaceLinks (links, mesh, faces, GrobIndex (cellType, c));
+	nbrhds.insert (links);
+}
+
+/// appends the given cells to the mesh and updates `nbrhds` incrementally
+static void AppendCells (Mesh& mesh,
+                         Neighborhoods& nbrhds,
+                         const GrobHashMap <GrobIndex>& faces,
+                         const grob_t cellType,
+                         const vector <index_t>& corners)
+{
+	const index_t numCorners = GrobDesc (cellType).num_corners ();
+	const index_t first = mesh.num (cellType);
+	for(size_t i = 0; i < corners.size(); i += numCorners)
+		mesh.insert (Grob (cellType, corners.data() + i));
+
+	links_t links;
+	for(index_t c = first; c < mesh.num (cellType); ++c)
+		CollectFaceLinks (links, mesh, faces, GrobIndex (cellType, c));
+	nbrhds.insert (links);
+}
+
+static uint64_t Key (const GrobIndex& gi)
+{
+	return (uint64_t (gi.grobType) << 32) | gi.index;
+}
+
+/// returns true if `nbrhds` holds the same links as freshly refreshed neighborhoods
+/** The order of the neighbors of a grob is ignored.*/
+static bool EqualsRefreshed (const Neighborhoods& nbrhds, SPMesh mesh)
+{
+	const Neighborhoods fresh (mesh, FACES, CELLS);
+	vector <uint64_t> a, b;
+	for(auto gt : GrobSet (FACES)) {
+		for(index_t i = 0; i < mesh->num (gt); ++i) {
+			a.clear ();
+			b.clear ();
+			for(auto nbr : nbrhds.neighbor_indices (GrobIndex (gt, i)))
+				a.push_back (Key (nbr));
+			for(auto nbr : fresh.neighbor_indices (GrobIndex (gt, i)))
+				b.push_back (Key (nbr));
+			sort (a.begin(), a.end());
+			sort (b.begin(), b.end());
+			if (a != b) {
+				cerr << "mismatch at " << GrobName (gt) << " " << i << endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+int main (int argc, char** argv)
+{
+	const string source = argc > 1 ? argv [1] : "40";
+	const int numRounds = argc > 2 ? atoi (argv [2]) : 10;
+	const index_t cellsPerRound = argc > 3 ? index_t (atoi (argv [3])) : 1000;
+
+	SPMesh mesh;
+	if (!source.empty () && all_of (source.begin(), source.end(), ::isdigit))
+		mesh = CreateHexGrid (index_t (stoi (source)));
+	else
+		mesh = CreateMeshFromFile (source);
+
+	if (!mesh->has (CELLS)) {
+		cerr << "The mesh doesn't contain any cells" << endl;
+		return 1;
+	}
+
+	if (!mesh->has (FACES))
+		CreateSideGrobs (*mesh, 2);
+
+	GrobHashMap <GrobIndex> faces;
+	faces.reserve (mesh->num (FACES));
+	for(auto gt : GrobSet (FACES)) {
+		for(index_t i = 0; i < mesh->num (gt); ++i)
+			faces.insert (make_pair (mesh->grob (GrobIndex (gt, i)), GrobIndex (gt, i)));
+	}
+
+	auto start = chrono::steady_clock::now ();
+	Neighborhoods nbrhds (mesh, FACES, CELLS);
+	const double refreshTime = Seconds (start);
+
+	mt19937 rng (0);
+	double removeTime = 0, appendTime = 0, compactTime = 0;
+	bool ok = true;
+	for(int round = 0; round < numRounds && ok; ++round) {
+		for(auto cellType : GrobSet (CELLS)) {
+			const index_t num = mesh->num (cellType);
+			if (num == 0)
+				continue;
+
+			const index_t numCorners = GrobDesc (cellType).num_corners ();
+			vector <index_t> cells;
+			vector <index_t> corners;
+			for(index_t i = 0; i < min (cellsPerRound, num); ++i)
+				cells.push_back (index_t (rng () % num));
+			sort (cells.begin(), cells.end());
+			cells.erase (unique (cells.begin(), cells.end()), cells.end());
+			for(auto c : cells) {
+				const index_t* first = mesh->grobs (cellType).raw_ptr () + c * numCorners;
+				corners.insert (corners.end(), first, first + numCorners);
+			}
+
+			start = chrono::steady_clock::now ();
+			RemoveCells (*mesh, nbrhds, faces, cellType, cells);
+			removeTime += Seconds (start);
+			ok = ok && EqualsRefreshed (nbrhds, mesh);
+
+			start = chrono::steady_clock::now ();
+			AppendCells (*mesh, nbrhds, faces, cellType, corners);
+			appendTime += Seconds (start);
+			ok = ok && EqualsRefreshed (nbrhds, mesh);
+		}
+
+		if (round % 2 == 1) {
+			start = chrono::steady_clock::now ();
+			nbrhds.compact ();
+			compactTime += Seconds (start);
+			ok = ok && EqualsRefreshed (nbrhds, mesh);
+		}
+	}
+
+	cout << "cells: " << mesh->num (CELLS) << ", faces: " << mesh->num (FACES) << endl;
+	cout << "refresh:            " << refreshTime << " s" << endl;
+	cout << "remove (per round): " << removeTime / numRounds << " s" << endl;
+	cout << "append (per round): " << appendTime / numRounds << " s" << endl;
+	cout << "compact (total):    " << compactTime << " s" << endl;
+	cout << (ok ? "check passed" : "check FAILED") << endl;
+	return ok ? 0 : 1;
+}
@@ -73,9 +73,10 @@ public:
 
 private:
 	ProfileStack () : m_outputThreshold (1) {}
+	///	each thread profiles its own nested sections and has its own output threshold
 	static ProfileStack& inst ()
 	{
-		static ProfileStack ps;
+		static thread_local ProfileStack ps;
 		return ps;
 	}
 
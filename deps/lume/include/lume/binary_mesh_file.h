@@ -0,0 +1,109 @@
+// This file is part of lume, a C++ library for lightweight unstructured meshes
+//
+// Copyright (C) 2018 Sebastian Reiter
+// Copyright (C) 2018 G-CSC, Goethe University Frankfurt
+// Author: Sebastian Reiter <s.b.reiter@gmail.com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __H__lume_binary_mesh_file
+#define __H__lume_binary_mesh_file
+
+#include <cstdint>
+#include <string>
+#include "mesh.h"
+
+namespace lume {
+
+/// Identifies the contents of a file without storing them
+struct FileStamp {
+	FileStamp () : size (0), modificationTime (0), contentHash (0) {}
+
+	bool operator == (const FileStamp& s) const
+	{
+		return size == s.size && modificationTime == s.modificationTime
+		       && contentHash == s.contentHash;
+	}
+
+	bool operator != (const FileStamp& s) const	{return !(*this == s);}
+
+	uint64_t	size;
+	int64_t		modificationTime;
+	uint64_t	contentHash;
+};
+
+/// Returns size and modification time of the given file and, if requested, a hash of its contents
+/** Throws a FileNotFoundError if the file doesn't exist.*/
+FileStamp CreateFileStamp (const std::string& filename, const bool hashContents);
+
+/// Computes a 64 bit hash of the given bytes
+/** The bytes are hashed in blocks of fixed size, which are processed
+ * concurrently. The result doesn't depend on the number of threads.*/
+uint64_t HashBytes (const void* data, const size_t size, const uint64_t seed = 0);
+
+/// Computes a 64 bit hash of the contents of the given file, see `HashBytes`
+uint64_t HashFileContents (const std::string& filename);
+
+/// Computes a 64 bit hash of the grobs, coordinates and array annexes of `mesh`
+/** Annexes of type RealArrayAnnex and IndexArrayAnnex are considered together
+ * with their names and grob types. Annexes of other types are ignored.*/
+uint64_t HashMeshContents (const Mesh& mesh);
+
+
+/// Writes grobs, coordinates and annexes of `mesh` to a lume binary mesh file
+/** Annexes of type RealArrayAnnex, IndexArrayAnnex and SubsetInfoAnnex are
+ * written, annexes of other types are skipped. The data is stored in the byte
+ * order and with the index and real types of the current platform.
+ *
+ * The file is written to a temporary file with a unique name in the directory
+ * of `filename` first, which then replaces `filename`.
+ *
+ * \param sourceStamp	stored in the header of the file. Allows to check whether
+ *						the binary file is up to date with the file from which
+ *						`mesh` was created, see `ReadBinaryMeshFileStamp`.
+ *
+ * \param writeCoords	If false, the "coords" annex is not written. Useful for
+ *						meshes which share the coordinates of another mesh.*/
+void WriteBinaryMeshFile (const Mesh& mesh,
+                          const std::string& filename,
+                          const FileStamp& sourceStamp = FileStamp (),
+                          const bool writeCoords = true);
+
+/// Loads a mesh from a lume binary mesh file
+/** The file is memory mapped and its array sections are copied to the arrays
+ * of the new mesh in one block each.
+ *
+ * Throws a FileParseError if the file is not a valid binary mesh file of the
+ * current platform, if a grob references a vertex which doesn't exist, or if
+ * the size of an annex doesn't match the number of its grobs.*/
+SPMesh CreateMeshFromBinaryFile (const std::string& filename);
+
+/// Reads the source stamp from the header of a lume binary mesh file
+FileStamp ReadBinaryMeshFileStamp (const std::string& filename);
+
+/// Replaces the source stamp in the header of a lume binary mesh file
+/** Used if the source file was touched without changing its contents, so
+ * that the binary file can be validated by size and modification time again.*/
+void WriteBinaryMeshFileStamp (const std::string& filename, const FileStamp& stamp);
+
+}//	end of namespace lume
+
+#endif	//__H__lume_binary_mesh_file
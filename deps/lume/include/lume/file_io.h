@@ -28,8 +28,10 @@
 #ifndef __H__lume_file_io
 #define __H__lume_file_io
 
+#include <cstdint>
 #include <string>
 #include <exception>
+#include <functional>
 #include "custom_exception.h"
 #include "mesh.h"
 
@@ -42,7 +44,48 @@ DECLARE_CUSTOM_EXCEPTION (FileSuffixError, FileIOError);
 DECLARE_CUSTOM_EXCEPTION (FileNotFoundError, FileIOError);
 DECLARE_CUSTOM_EXCEPTION (FileParseError, FileIOError);
 
-SPMesh CreateMeshFromFile (std::string filename);
+/// thrown by the loading functions if loading was cancelled through a `LoadProgressCallback`
+DECLARE_CUSTOM_EXCEPTION (LoadCancelledError, LumeError);
+
+/// Receives the progress of loading a mesh
+/** \param phase		short description of the current phase, e.g. "parsing"
+ * \param bytesDone	number of bytes processed in the current phase
+ * \param bytesTotal	number of bytes to process in the current phase or 0 if unknown
+ * \returns	false to cancel loading. The loading function then throws a
+ *			`LoadCancelledError`.
+ *
+ * The callback is invoked on the loading thread.*/
+using LoadProgressCallback = std::function <bool (const char* phase,
+                                                  uint64_t bytesDone,
+                                                  uint64_t bytesTotal)>;
+
+/// suffix which is appended to the name of a mesh file to obtain the name of its binary cache
+static const char* const BINARY_MESH_CACHE_SUFFIX = ".lumemesh";
+
+/// Loads a mesh from a .stl, .ele or .ugx file
+/** \param useBinaryCache	If true, the mesh is loaded from a binary cache next
+ *							to `filename` (see `BINARY_MESH_CACHE_SUFFIX`) if the
+ *							cache is up to date with the source file. Otherwise
+ *							the source is parsed and the cache is (re-)written.
+ *							Failures to write the cache are ignored.
+ *
+ * \param progress		(optional) is called repeatedly during loading and
+ *						allows to cancel loading (see `LoadProgressCallback`).
+ *
+ * \param streamUGX		If true, ugx files are read through `CreateMeshFromUGXStream`
+ *						instead of being mapped to memory and parsed in parallel.
+ *						Use this for files which don't fit into the available memory.*/
+SPMesh CreateMeshFromFile (std::string filename,
+                           const bool useBinaryCache = false,
+                           const LoadProgressCallback& progress = LoadProgressCallback (),
+                           const bool streamUGX = false);
+
+/// Loads a mesh from a ugx file without holding the file in memory
+/** The file is parsed sequentially through a window of fixed size and the
+ * data is written directly to the returned mesh. Memory consumption apart from
+ * the mesh itself is thus independent of the file size, at the cost of a
+ * slower, single threaded parse.*/
+SPMesh CreateMeshFromUGXStream (std::string filename);
 
 }//	end of namespace lume
 
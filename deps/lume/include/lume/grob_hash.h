@@ -24,14 +24,350 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
 // THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
-
 #ifndef __H__lume_grob_hash
 #define __H__lume_grob_hash
 
-#include <unordered_set>
-#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "custom_exception.h"
 #include "grob.h"
 
+namespace lume {
+
+namespace impl {
+///	sorts the corners of a grob (insertion sort, grobs have few corners)
+inline index_t SortedCorners (index_t* cornersOut, const Grob& grob)
+{
+	const index_t numCorners = grob.corners (cornersOut);
+	for(index_t i = 1; i < numCorners; ++i) {
+		const index_t c = cornersOut [i];
+		index_t j = i;
+		for(; j > 0 && cornersOut [j - 1] > c; --j)
+			cornersOut [j] = cornersOut [j - 1];
+		cornersOut [j] = c;
+	}
+	return numCorners;
+}
+
+///	hash of a grob type and its sorted corners
+inline std::uint64_t HashSortedCorners (const grob_t grobType,
+                                        const index_t* sortedCorners,
+                                        const index_t numCorners)
+{
+	std::uint64_t h = static_cast <std::uint64_t> (grobType) + 1;
+	for(index_t i = 0; i < numCorners; ++i)
+		h = (h ^ sortedCorners [i]) * 0x9E3779B97F4A7C15ull;
+//	finalizer of splitmix64
+	h ^= h >> 30;
+	h *= 0xBF58476D1CE4E5B9ull;
+	h ^= h >> 27;
+	h *= 0x94D049BB133111EBull;
+	h ^= h >> 31;
+	return h;
+}
+
+///	order independent hash of a grob
+inline std::uint64_t HashGrob (const Grob& grob)
+{
+	index_t sorted [TOTAL_MAX_CORNERS];
+	const index_t numCorners = SortedCorners (sorted, grob);
+	return HashSortedCorners (grob.grob_type (), sorted, numCorners);
+}
+
+
+struct NoValue {};
+
+///	Open addressing hash table with grobs as keys
+/** Linear probing is used on a power-of-two sized slot array, whose size is
+ * doubled once the load factor exceeds 0.7. Each slot holds a 32 bit hash,
+ * the index of its entry and the offset of the entry's key.
+ *
+ * Keys are stored densely in insertion order. Each key consists of the grob
+ * type, the sorted corners and the corners in their original order. Probing
+ * thus compares the sorted corners of a matching slot directly, without
+ * sorting them again. Keys are compared regardless of order and orientation.
+ * Iteration is fast and deterministic and yields grobs with their original
+ * corner order.
+ *
+ * Use `GrobHash` and `GrobHashMap` instead of this class.*/
+template <class TValue>
+class GrobTable {
+	struct Slot {
+		std::uint32_t	hash;
+		index_t			entry;	// NO_INDEX marks an empty slot
+		index_t			key;	// offset of the key of the entry in m_keys
+	};
+
+public:
+	template <class TTable>
+	class Iterator {
+	public:
+		Iterator (TTable* table, index_t i) : m_table (table), m_i (i)	{}
+
+		Grob grob () const						{return m_table->entry_grob (m_i);}
+		auto value () const -> decltype (std::declval <TTable&> ().value_at (0))	{return m_table->value_at (m_i);}
+
+		Iterator& operator ++ ()				{++m_i; return *this;}
+		bool operator == (const Iterator& it) const	{return m_i == it.m_i;}
+		bool operator != (const Iterator& it) const	{return m_i != it.m_i;}
+
+		index_t entry_index () const			{return m_i;}
+
+	private:
+		TTable*	m_table;
+		index_t	m_i;
+	};
+
+	using iterator = Iterator <GrobTable>;
+	using const_iterator = Iterator <const GrobTable>;
+
+	size_t size () const			{return m_keyOffsets.size();}
+	bool empty () const				{return m_keyOffsets.empty();}
+
+	///	removes all entries but keeps the allocated memory
+	void clear ()
+	{
+		if (empty ())
+			return;
+		for(auto& s : m_slots)
+			s.entry = NO_INDEX;
+		m_keyOffsets.clear ();
+		m_keys.clear ();
+		m_values.clear ();
+	}
+
+	///	makes sure that `n` entries can be inserted without rehashing
+	void reserve (const size_t n)
+	{
+		size_t cap = 16;
+		while (cap * 7 < n * 10)
+			cap *= 2;
+		if (cap > m_slots.size())
+			rehash (cap);
+		m_keyOffsets.reserve (n);
+		m_values.reserve (n);
+	}
+
+	iterator begin ()				{return iterator (this, 0);}
+	iterator end ()					{return iterator (this, static_cast <index_t> (size()));}
+	const_iterator begin () const	{return const_iterator (this, 0);}
+	const_iterator end () const		{return const_iterator (this, static_cast <index_t> (size()));}
+
+	iterator find (const Grob& grob)
+	{
+		const index_t e = find_entry (grob);
+		return e == NO_INDEX ? end () : iterator (this, e);
+	}
+
+	const_iterator find (const Grob& grob) const
+	{
+		const index_t e = find_entry (grob);
+		return e == NO_INDEX ? end () : const_iterator (this, e);
+	}
+
+	size_t count (const Grob& grob) const	{return find_entry (grob) != NO_INDEX ? 1 : 0;}
+
+	///	inserts the grob if no equal grob is contained in the table
+	/** \returns an iterator to the entry of the grob and `true` if it was inserted.*/
+	std::pair <iterator, bool> insert (const Grob& grob, const TValue& value = TValue ())
+	{
+		if ((size() + 1) * 10 > m_slots.size() * 7)
+			rehash (std::max <size_t> (16, 2 * m_slots.size()));
+
+		index_t sorted [TOTAL_MAX_CORNERS];
+		const index_t numCorners = SortedCorners (sorted, grob);
+		const std::uint32_t h = slot_hash (grob.grob_type(), sorted, numCorners);
+
+		const size_t i = find_slot (grob.grob_type(), sorted, numCorners, h);
+		Slot& s = m_slots [i];
+		if (s.entry != NO_INDEX)
+			return std::make_pair (iterator (this, s.entry), false);
+
+		s.hash = h;
+		s.entry = static_cast <index_t> (size());
+		s.key = static_cast <index_t> (m_keys.size());
+		m_keyOffsets.push_back (s.key);
+		m_keys.push_back (static_cast <index_t> (grob.grob_type()));
+		m_keys.insert (m_keys.end(), sorted, sorted + numCorners);
+		for(index_t j = 0; j < numCorners; ++j)
+			m_keys.push_back (grob.corner (j));
+		m_values.push_back (value);
+		return std::make_pair (iterator (this, s.entry), true);
+	}
+
+	///	the grob of the i-th entry. Its corners are valid until the next insertion.
+	Grob entry_grob (const index_t i) const
+	{
+		const index_t* key = m_keys.data() + m_keyOffsets [i];
+		const grob_t grobType = static_cast <grob_t> (key [0]);
+		return Grob (grobType, key + 1 + GrobDesc (grobType).num_corners ());
+	}
+
+	TValue& value_at (const index_t i)				{return m_values [i];}
+	const TValue& value_at (const index_t i) const	{return m_values [i];}
+
+protected:
+	///	returns the index of the entry of the given grob or NO_INDEX
+	index_t find_entry (const Grob& grob) const
+	{
+		if (m_slots.empty ())
+			return NO_INDEX;
+
+		index_t sorted [TOTAL_MAX_CORNERS];
+		const index_t numCorners = SortedCorners (sorted, grob);
+		const std::uint32_t h = slot_hash (grob.grob_type(), sorted, numCorners);
+		return m_slots [find_slot (grob.grob_type(), sorted, numCorners, h)].entry;
+	}
+
+private:
+	static std::uint32_t slot_hash (const grob_t grobType, const index_t* sorted, const index_t numCorners)
+	{
+		return static_cast <std::uint32_t> (HashSortedCorners (grobType, sorted, numCorners) >> 32);
+	}
+
+	///	returns the slot of the given grob or the empty slot where it would be inserted
+	size_t find_slot (const grob_t grobType,
+	                  const index_t* sorted,
+	                  const index_t numCorners,
+	                  const std::uint32_t h) const
+	{
+		const size_t mask = m_slots.size() - 1;
+		for(size_t i = h & mask;; i = (i + 1) & mask) {
+			const Slot& s = m_slots [i];
+			if (s.entry == NO_INDEX
+			    || (s.hash == h && equals_key (s.key, grobType, sorted, numCorners)))
+			{
+				return i;
+			}
+		}
+	}
+
+	bool equals_key (const index_t keyOffset,
+	                 const grob_t grobType,
+	                 const index_t* sorted,
+	                 const index_t numCorners) const
+	{
+		const index_t* key = m_keys.data() + keyOffset;
+		if (key [0] != static_cast <index_t> (grobType))
+			return false;
+
+		for(index_t i = 0; i < numCorners; ++i) {
+			if (key [i + 1] != sorted [i])
+				return false;
+		}
+		return true;
+	}
+
+	void rehash (const size_t newCapacity)
+	{
+		std::vector <Slot> oldSlots (newCapacity, Slot {0, NO_INDEX, 0});
+		oldSlots.swap (m_slots);
+
+		const size_t mask = m_slots.size() - 1;
+		for(const auto& s : oldSlots) {
+			if (s.entry == NO_INDEX)
+				continue;
+			size_t i = s.hash & mask;
+			while (m_slots [i].entry != NO_INDEX)
+				i = (i + 1) & mask;
+			m_slots [i] = s;
+		}
+	}
+
+	std::vector <Slot>		m_slots;
+	std::vector <index_t>	m_keyOffsets;	// offset of the key of each entry in m_keys
+	std::vector <index_t>	m_keys;
+	std::vector <TValue>	m_values;
+};
+
+}//	end of namespace impl
+
+
+///	A set of grobs. Grobs are considered equal if they have the same type and the same corners.
+/** Dereferencing an iterator yields a `Grob` whose corners are stored in the set.
+ * Such grobs are valid until the next insertion. Iteration follows the order
+ * of insertion.*/
+class GrobHash : public impl::GrobTable <impl::NoValue> {
+	using base_t = impl::GrobTable <impl::NoValue>;
+public:
+	class const_iterator : public base_t::const_iterator {
+	public:
+		const_iterator (const base_t::const_iterator& it) : base_t::const_iterator (it) {}
+		Grob operator * () const	{return this->grob ();}
+	};
+	using iterator = const_iterator;
+
+	const_iterator begin () const	{return base_t::begin ();}
+	const_iterator end () const		{return base_t::end ();}
+
+	std::pair <const_iterator, bool> insert (const Grob& grob)
+	{
+		auto r = base_t::insert (grob);
+		return std::make_pair (const_iterator (base_t::const_iterator (this, r.first.entry_index())), r.second);
+	}
+};
+
+
+///	Associates values with grobs. Grobs are considered equal if they have the same type and the same corners.
+/** Dereferencing an iterator yields a pair of the `Grob` and a reference to its value.
+ * Such grobs are valid until the next insertion. Iteration follows the order
+ * of insertion.*/
+template <class T>
+class GrobHashMap : public impl::GrobTable <T> {
+	using base_t = impl::GrobTable <T>;
+public:
+	class iterator : public base_t::iterator {
+	public:
+		iterator (const typename base_t::iterator& it) : base_t::iterator (it) {}
+		std::pair <Grob, T&> operator * () const	{return std::pair <Grob, T&> (this->grob (), this->value ());}
+	};
+
+	class const_iterator : public base_t::const_iterator {
+	public:
+		const_iterator (const typename base_t::const_iterator& it) : base_t::const_iterator (it) {}
+		std::pair <Grob, const T&> operator * () const	{return std::pair <Grob, const T&> (this->grob (), this->value ());}
+	};
+
+	iterator begin ()				{return base_t::begin ();}
+	iterator end ()					{return base_t::end ();}
+	const_iterator begin () const	{return base_t::begin ();}
+	const_iterator end () const		{return base_t::end ();}
+
+	iterator find (const Grob& grob)				{return base_t::find (grob);}
+	const_iterator find (const Grob& grob) const	{return base_t::find (grob);}
+
+	std::pair <iterator, bool> insert (const std::pair <Grob, T>& entry)
+	{
+		auto r = base_t::insert (entry.first, entry.second);
+		return std::make_pair (iterator (r.first), r.second);
+	}
+
+	T& operator [] (const Grob& grob)
+	{
+		return base_t::value_at (base_t::insert (grob).first.entry_index());
+	}
+
+	T& at (const Grob& grob)
+	{
+		return const_cast <T&> (static_cast <const GrobHashMap&> (*this).at (grob));
+	}
+
+	const T& at (const Grob& grob) const
+	{
+		const index_t e = base_t::find_entry (grob);
+		if (e == NO_INDEX)
+			throw LumeError ("GrobHashMap::at: Grob not contained in map");
+		return base_t::value_at (e);
+	}
+};
+
+}//	end of namespace lume
+
+
 namespace std
 {
     template<> struct hash<lume::Grob>
@@ -40,24 +376,9 @@ namespace std
         typedef std::size_t result_type;
         result_type operator()(argument_type const& grob) const noexcept
         {
-        	using namespace lume;
-        	const index_t numCorners = grob.num_corners();
-        	std::size_t h = 0;
-        	for(index_t i = 0; i < numCorners; ++i){
-        		const index_t c = grob.corner(i);
-        		h += c * c;
-        	}
-        	return 10^8 * (grob.grob_type() + 1) + h;
+        	return static_cast <result_type> (lume::impl::HashGrob (grob));
         }
     };
 }//	end of namespace std
 
-
-namespace lume {
-	using GrobHash = std::unordered_set <Grob>;
-
-	template <class T>
-	using GrobHashMap = std::unordered_map <Grob, T>;
-}//	end of namespace lume
-
 #endif	//__H__lume_grob_hash
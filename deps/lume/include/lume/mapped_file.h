@@ -0,0 +1,67 @@
+// This file is part of lume, a C++ library for lightweight unstructured meshes
+//
+// Copyright (C) 2018 Sebastian Reiter
+// Copyright (C) 2018 G-CSC, Goethe University Frankfurt
+// Author: Sebastian Reiter <s.b.reiter@gmail.com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __H__lume_mapped_file
+#define __H__lume_mapped_file
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace lume {
+
+/// Provides the contents of a file as a buffer, which is terminated by an additional zero
+/** On POSIX systems the file is memory mapped through a private copy-on-write
+ * mapping. Pages are thus only read from disk when they are accessed and changes
+ * to the buffer never reach the file. On other systems the file is read into
+ * memory as a whole.
+ *
+ * Throws a FileNotFoundError if the file can't be opened.*/
+class MappedFile {
+public:
+	explicit MappedFile (const std::string& filename);
+	~MappedFile ();
+
+	MappedFile (const MappedFile&) = delete;
+	MappedFile& operator = (const MappedFile&) = delete;
+
+	/// the contents of the file. `data()[size()]` is zero.
+	char* data ()				{return m_data;}
+	const char* data () const	{return m_data;}
+
+	/// size of the file in bytes
+	size_t size () const		{return m_size;}
+
+private:
+	char*				m_data;
+	size_t				m_size;
+	size_t				m_mapSize;
+	std::vector <char>	m_buffer;
+};
+
+}//	end of namespace lume
+
+#endif	//__H__lume_mapped_file
@@ -28,14 +28,92 @@
 #ifndef __H__lume_neighborhoods
 #define __H__lume_neighborhoods
 
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include "grob_index.h"
 #include "mesh.h" // use forward instead
 #include "neighbors.h"
 
 namespace lume {
 
+namespace impl {
+	/// Packs the GrobIndices of grobs of a grob set into single indices
+	/** If only one grob type of the grob set is present in the mesh, packed
+	 * indices equal the grob indices. Otherwise the rank of the grob type in the
+	 * grob set is stored in the upper bits. Packed indices are thus ordered by
+	 * the rank of their grob type first and by their grob index second.*/
+	class PackedGrobIndex {
+	public:
+		PackedGrobIndex () :
+			m_shift (32),
+			m_mask (NO_INDEX)
+		{
+			m_types [0] = NO_GROB;
+		}
+
+		PackedGrobIndex (const Mesh& mesh, const GrobSet grobSet) :
+			PackedGrobIndex ()
+		{
+			index_t numPresent = 0;
+			for(auto gt : grobSet)
+				numPresent += mesh.has (gt) ? 1 : 0;
+
+			index_t rank = 0;
+			for(auto gt : grobSet) {
+				if (numPresent > 1 || mesh.has (gt)) {
+					m_ranks [gt] = rank;
+					m_types [rank++] = gt;
+				}
+			}
+
+			if (numPresent > 1) {
+				m_shift = 32 - 2;
+				m_mask = (index_t (1) << m_shift) - 1;
+				for(auto gt : grobSet) {
+					if (mesh.num (gt) > m_mask) {
+						throw LumeError (std::string ("PackedGrobIndex: Too many grobs of type ").
+						                 append (GrobName (gt)));
+					}
+				}
+			}
+		}
+
+		index_t pack (const grob_t grobType, const index_t index) const
+		{
+			return static_cast <index_t> (std::uint64_t (m_ranks [grobType]) << m_shift) | index;
+		}
+
+		GrobIndex unpack (const index_t packed) const
+		{
+			return GrobIndex (m_types [std::uint64_t (packed) >> m_shift], packed & m_mask);
+		}
+
+		/// returns false if the given grob type or index can't be represented
+		bool can_pack (const grob_t grobType, const index_t index) const
+		{
+			return m_types [m_ranks [grobType]] == grobType && index <= m_mask;
+		}
+
+	private:
+		index_t	m_shift;
+		index_t	m_mask;
+		index_t	m_ranks [NUM_GROB_TYPES] = {0};
+		grob_t	m_types [MAX_GROB_SET_SIZE];
+	};
+}// end of namespace impl
+
 
 /// Gives access to the neighbors of all entities of the mesh
+/** Neighbors are stored in CSR layout as packed grob indices
+ * (see `impl::PackedGrobIndex`). If all neighbors are of the same grob type,
+ * a single index is thus stored per neighbor.
+ *
+ * Links can be added and removed incrementally through `insert` and `erase`.
+ * Changes are kept in an overlay, which holds the complete neighbor lists of
+ * all modified center grobs and which is merged into the CSR arrays once it
+ * grows too large.*/
 class Neighborhoods {
 	friend class NeighborIndices;
 	friend class NeighborGrobs;
@@ -71,6 +149,49 @@ public:
 	void refresh (SPMesh mesh, GrobSet grobTypes, const Neighborhoods& grobConnections);
 	/** \} */
 
+	/// Creates the sides of `grobSet` and the neighborhood between those sides and `grobSet`
+	/** Sides of dimension `grobSet.dim() - 1` (e.g. the faces of all cells) are
+	 * created and their neighborhoods are filled in one pass. Afterwards the
+	 * instance equals `Neighborhoods (mesh, grobSet.side_set(), grobSet)`.
+	 *
+	 * \note	Existing grobs of dimension `grobSet.dim() - 1` are replaced.
+	 * \sa	CreateSideGrobs*/
+	void create_sides_and_refresh (SPMesh mesh, GrobSet grobSet);
+
+	/// Adds links between center grobs (first) and neighbor grobs (second)
+	/** Grobs may have been appended to the mesh since the last refresh. Links
+	 * which already exist are ignored. New neighbors are appended to the
+	 * neighbors of a center grob.
+	 *
+	 * \note	For neighborhoods between grobs of the same grob set, both
+	 *			directions of a link have to be specified.
+	 * \note	Previously obtained NeighborIndices and NeighborGrobs are invalidated.*/
+	void insert (const std::vector <std::pair <GrobIndex, GrobIndex>>& links);
+
+	/// Removes links between center grobs (first) and neighbor grobs (second)
+	/** Links which don't exist are ignored. Grob indices are not changed by
+	 * this method, all links refer to the indices of the mesh at the time of
+	 * the call.
+	 *
+	 * To remove grobs from the mesh while keeping the indices of all other grobs
+	 * consecutive, fill the gaps with grobs from the end of the grob array:
+	 * erase the links of the removed grobs and of the grobs which will be moved
+	 * first, then move the corners and shrink the grob array, and finally insert
+	 * the links of the moved grobs with their new indices. Indices of removed
+	 * grobs may thus be reused by other grobs. If grobs are renumbered in any
+	 * other way, `refresh` has to be called instead.
+	 * See `bench/neighborhoods_bench.cpp` for an example.
+	 *
+	 * \note	Previously obtained NeighborIndices and NeighborGrobs are invalidated.*/
+	void erase (const std::vector <std::pair <GrobIndex, GrobIndex>>& links);
+
+	/// Merges changes from `insert` and `erase` into the CSR arrays
+	/** This is done automatically once the number of pending changes gets large.
+	 * \note	Previously obtained NeighborIndices and NeighborGrobs are invalidated.*/
+	void compact ();
+
+	bool has_pending_changes () const	{return !m_overlay.empty();}
+
     SPMesh mesh ();
 
     NeighborIndices neighbor_indices (const GrobIndex gi) const;
@@ -82,13 +203,24 @@ public:
     GrobSet neighbor_grob_set () const	{return m_neighborGrobTypes;}
     
 private:
+	using overlay_t = std::unordered_map <std::uint64_t, std::vector <index_t>>;
+
 	index_t base_index (const GrobIndex gi) const;
 	index_t offset_index (const GrobIndex& gi) const;
-	const index_t* first_neighbor (const GrobIndex& gi) const;
+	void neighbor_range (const GrobIndex& gi, const index_t*& firstOut, index_t& numOut) const;
+
+	void reset_overlay ();
+	void check_link (const std::pair <GrobIndex, GrobIndex>& link) const;
+	std::vector <index_t>& overlay_neighbors (const GrobIndex& gi);
+	static std::uint64_t overlay_key (const GrobIndex& gi);
 
     IndexArrayAnnex m_offsets;
     IndexArrayAnnex m_nbrs;
+    impl::PackedGrobIndex	m_nbrPacking;
     index_t         m_grobBaseInds [NUM_GROB_TYPES];
+    index_t         m_numCenters [NUM_GROB_TYPES];
+    overlay_t		m_overlay;
+    index_t			m_overlaySize;
     SPMesh			m_mesh;
     GrobSet			m_centerGrobTypes;
     GrobSet			m_neighborGrobTypes;
@@ -96,40 +228,36 @@ private:
 
 
 namespace impl {
-	/// Computes the offset for each grob in `grobs` into an neighborhood array
-	/** The results are stored in the specified index array, based on the indices
-	 * given in the `grobToIndexMap`. The `grobToIndexMap` can e.g. be created using
-	 * the method `FillGrobToIndexMap` on the `grobs` grob set.
-	 *
-	 * \returns	an array of the size `mesh.num (grobs)`. For each grob, it stores
-	 *			an offset into an array in which indices of neighboring grobs from
-	 *			the set `nbrGrobs` can be stored.
-	 *				- hint: `offsetsOut[i+1] - offsetsOut[i]` corresponds to the
-	 *				  number of neighbors of the i'th grob.
-	 *				- hint: `offsetsOut[mesh.num(grobs)]` or `offsetsOut.back()`
-	 *				  corresponds to the sum of the neighborhood sizes from all
-	 *				  grobs of type `grobs`.
-	 *
-	 * \warning	it is assumed that the highest index provided by `grobToIndexMap`
-	 *			is smaller than `mesh.num(grobs)`.
-	 *			
-	 * \sa FillGrobToIndexMap */
-	template <class TIndexVector>
-	void FillHigherDimNeighborOffsetMap (TIndexVector& offsetsOut,
-				                         Mesh& mesh,
-				                     	 GrobSet grobSet,
-				                     	 GrobSet nbrGrobSet,
-				                     	 const GrobHashMap <index_t>& grobToIndexMap);
-
 	template <class TIndexVector>
 	void FillLowerDimNeighborOffsetMap (TIndexVector& offsetsOut,
 				                        Mesh& mesh,
 				                     	GrobSet grobSet,
 				                     	GrobSet nbrGrobSet);
 
+	/// Fills the neighbor map of center grobs by transposing the incidences of neighbor grobs
+	/** Center grobs are indexed consecutively (`numCenters` in total). For each
+	 * grob of `nbrGrobSet` and each of its sides of dimension `centerDim`,
+	 * `centerIndex` has to return the consecutive index of the corresponding
+	 * center grob, or `NO_INDEX` if there is none. It is called from multiple
+	 * threads.
+	 *
+	 * \param centerIndex	`index_t (const Grob& nbrGrob, index_t slot, index_t iside)`.
+	 *						`slot` enumerates the sides of all neighbor grobs
+	 *						consecutively in the order of the types in `nbrGrobSet`.*/
+	template <class TIndexVector, class TCenterIndexFunc>
+	void FillHigherDimNeighborMapFromIncidences (TIndexVector& nbrMapOut,
+	                                             TIndexVector& offsetsOut,
+	                                             const PackedGrobIndex& nbrPacking,
+	                                             const index_t numCenters,
+	                                             Mesh& mesh,
+	                                             const index_t centerDim,
+	                                             GrobSet nbrGrobSet,
+	                                             const TCenterIndexFunc& centerIndex);
+
 	template <class TIndexVector>
 	void FillHigherDimNeighborMap (TIndexVector& nbrMapOut,
 	                        	   TIndexVector& offsetsOut,
+	                        	   const PackedGrobIndex& nbrPacking,
 	                        	   index_t* grobBaseIndsOut,
 	                        	   Mesh& mesh,
 	                        	   GrobSet grobSet,
@@ -138,6 +266,7 @@ namespace impl {
 	template <class TIndexVector>
 	void FillLowerDimNeighborMap (TIndexVector& nbrMapOut,
 	                        	   TIndexVector& offsetsOut,
+	                        	   const PackedGrobIndex& nbrPacking,
 	                        	   index_t* grobBaseIndsOut,
 	                        	   Mesh& mesh,
 	                        	   GrobSet grobSet,
@@ -149,6 +278,7 @@ namespace impl {
 	template <class TIndexVector>
 	void FillNeighborMap (TIndexVector& elemMapOut,
                             TIndexVector& offsetsOut,
+                            const PackedGrobIndex& nbrPacking,
                             index_t* grobBaseIndsOut,
                             Mesh& mesh,
                             GrobSet elemSet,
@@ -160,6 +290,7 @@ namespace impl {
 	template <class TIndexVector>
 	void FillNeighborMap (TIndexVector& elemMapOut,
                             TIndexVector& offsetsOut,
+                            const PackedGrobIndex& nbrPacking,
                             index_t* grobBaseIndsOut,
                             Mesh& mesh,
                             GrobSet elemSet,
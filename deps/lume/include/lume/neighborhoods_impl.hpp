@@ -27,49 +27,88 @@
 #ifndef __H__lume_neighborhoods_impl
 #define __H__lume_neighborhoods_impl
 
+#include <atomic>
+#include <memory>
 #include "neighborhoods.h"
+#include "parallel_algorithms.h"
 #include "topology.h"
 
 namespace lume {
 namespace impl {
 
-template <class TIndexVector>
-void FillHigherDimNeighborOffsetMap (TIndexVector& offsetsOut,
-			                         Mesh& mesh,
-			                     	 GrobSet grobSet,
-			                     	 GrobSet nbrGrobSet,
-			                     	 const GrobHashMap <index_t>& grobToIndexMap)
+template <class TIndexVector, class TCenterIndexFunc>
+void FillHigherDimNeighborMapFromIncidences (TIndexVector& nbrMapOut,
+                                             TIndexVector& offsetsOut,
+                                             const PackedGrobIndex& nbrPacking,
+                                             const index_t numCenters,
+                                             Mesh& mesh,
+                                             const index_t centerDim,
+                                             GrobSet nbrGrobSet,
+                                             const TCenterIndexFunc& centerIndex)
 {
-	offsetsOut.clear ();
-	offsetsOut.resize (mesh.num (grobSet) + 1, 0);
+	std::unique_ptr <std::atomic <index_t> []> nbrFill (new std::atomic <index_t> [numCenters + 1]);
+	parallel_for (index_t (0), numCenters + 1, [&] (const index_t i) {nbrFill [i] = 0;});
+
+//	calls `func (nbrGrobType, nbrIndex, centerIndex)` for each side of each neighbor grob
+	auto forEachIncidence = [&] (const auto& func) {
+		index_t slotBase = 0;
+		for (auto nbrGrobType : nbrGrobSet) {
+			if (!mesh.has (nbrGrobType))
+				continue;
+			const GrobArray& nbrGrobs = mesh.grobs (nbrGrobType);
+			const index_t numSides = GrobDesc (nbrGrobType).num_sides (centerDim);
+			parallel_for (index_t (0), nbrGrobs.size(), [&] (const index_t inbr) {
+				const Grob nbrGrob = nbrGrobs [inbr];
+				const index_t slot = slotBase + inbr * numSides;
+				for(index_t iside = 0; iside < numSides; ++iside)
+					func (nbrGrobType, inbr, centerIndex (nbrGrob, slot + iside, iside));
+			});
+			slotBase += nbrGrobs.size() * numSides;
+		}
+	};
 
-	const index_t grobSetDim = grobSet.dim();
-	const index_t nbrGrobSetDim = nbrGrobSet.dim();
+//	count the neighbors of each center grob
+	std::atomic <bool> missingCenter (false);
+	forEachIncidence ([&] (const grob_t, const index_t, const index_t eind) {
+		if (eind == NO_INDEX)
+			missingCenter = true;
+		else
+			nbrFill [eind].fetch_add (1, std::memory_order_relaxed);
+	});
 
-	if (nbrGrobSetDim <= grobSetDim)
-		throw LumeError ("neighbor dimension has to be higher than central grob set dimension");
+	if (missingCenter)
+		throw LumeError ("FillHigherDimNeighborMap: Side of a neighbor grob is not contained in the central grob set");
 
-	for (auto nbrGrobType : nbrGrobSet) {
-		for(auto nbrGrob : mesh.grobs (nbrGrobType)) {
-			for(index_t iside = 0; iside < nbrGrob.num_sides(grobSetDim); ++iside) {
-				++offsetsOut[grobToIndexMap.at(nbrGrob.side (grobSetDim, iside))];
-			}
-		}
-	}
+	offsetsOut.clear ();
+	offsetsOut.resize (numCenters + 1, 0);
+	parallel_exclusive_scan (nbrFill.get(), nbrFill.get() + numCenters + 1, offsetsOut.begin(), index_t (0));
+	parallel_for (index_t (0), numCenters + 1, [&] (const index_t i) {nbrFill [i] = offsetsOut [i];});
 
-	// Compute an offset into a neighbor map for each element (convert count -> offset)
-	index_t offset = 0;
-	for(index_t i = 0; i < offsetsOut.size(); ++i) {
-		const index_t curOffset = offset;
-		offset += offsetsOut[i];
-		offsetsOut[i] = curOffset;
-	}
+	nbrMapOut.clear ();
+	nbrMapOut.resize (offsetsOut.back());
+
+	forEachIncidence ([&] (const grob_t nbrGrobType, const index_t inbr, const index_t eind) {
+		nbrMapOut [nbrFill [eind].fetch_add (1, std::memory_order_relaxed)]
+			= nbrPacking.pack (nbrGrobType, inbr);
+	});
+
+//	restore the order in which neighbors appear in the mesh. Packed indices are
+//	ordered by the rank of their type in nbrGrobSet first.
+	parallel_for (index_t (0), numCenters, [&] (const index_t icenter) {
+		const index_t begin = offsetsOut [icenter];
+		const index_t end = offsetsOut [icenter + 1];
+		for(index_t i = begin + 1; i < end; ++i) {
+			for(index_t j = i; j > begin && nbrMapOut [j] < nbrMapOut [j-1]; --j)
+				std::swap (nbrMapOut [j], nbrMapOut [j-1]);
+		}
+	});
 }
 
 
 template <class TIndexVector>
 void FillHigherDimNeighborMap (TIndexVector& nbrMapOut,
                         	   TIndexVector& offsetsOut,
+                        	   const PackedGrobIndex& nbrPacking,
                         	   index_t* grobBaseIndsOut,
                         	   Mesh& mesh,
                         	   GrobSet grobSet,
@@ -81,32 +120,15 @@ void FillHigherDimNeighborMap (TIndexVector& nbrMapOut,
 	if (nbrGrobSetDim <= grobSetDim)
 		throw LumeError ("neighbor dimension has to be higher than central grob set dimension");
 
-	GrobHashMap <index_t> grobToIndexMap;
-	FillGrobToIndexMap (grobToIndexMap, grobBaseIndsOut, mesh, grobSet);
-
-	FillHigherDimNeighborOffsetMap (offsetsOut, mesh, grobSet, nbrGrobSet, grobToIndexMap);
+	const GrobIndexTable centerTable (mesh, grobSet);
+	VecCopy (grobBaseIndsOut, NUM_GROB_TYPES, centerTable.base_inds());
 
-	nbrMapOut.clear ();
-	nbrMapOut.resize (offsetsOut.back() * 2, NO_GROB);
-	
-	for (auto nbrGrobType : nbrGrobSet) {
-		index_t nbrGrobIndex = 0;
-		for(auto nbrGrob : mesh.grobs (nbrGrobType)) {
-			for(index_t iside = 0; iside < nbrGrob.num_sides(grobSetDim); ++iside) {
-				const index_t eind = grobToIndexMap.at (nbrGrob.side (grobSetDim, iside));
-				const index_t offset = 2 * offsetsOut [eind];
-				const index_t numAss = offsetsOut [eind + 1] - offsetsOut [eind];
-				for(index_t j = offset; j < offset + 2 * numAss; j+=2) {
-					if (nbrMapOut [j] == NO_GROB){
-						nbrMapOut [j] = nbrGrobType;
-						nbrMapOut [j+1] = nbrGrobIndex;
-						break;
-					}
-				}
-			}
-			++nbrGrobIndex;
-		}
-	}
+	FillHigherDimNeighborMapFromIncidences (
+			nbrMapOut, offsetsOut, nbrPacking, centerTable.size(), mesh, grobSetDim, nbrGrobSet,
+			[&centerTable, grobSetDim] (const Grob& nbrGrob, const index_t, const index_t iside)
+			{
+				return centerTable.find (nbrGrob.side (grobSetDim, iside));
+			});
 }
 
 
@@ -125,19 +147,22 @@ void FillLowerDimNeighborOffsetMap (TIndexVector& offsetsOut,
 	if (nbrGrobSetDim >= grobSetDim)
 		throw LumeError ("neighbor dimension has to be lower than central grob set dimension");
 
-	offsetsOut [0] = 0;
-	index_t counter = 1;
+	index_t counter = 0;
 	for(auto grobType : grobSet) {
 		for(auto grob : mesh.grobs (grobType)) {
-			offsetsOut [counter] = offsetsOut [counter - 1] + grob.num_sides (nbrGrobSetDim);
+			offsetsOut [counter] = grob.num_sides (nbrGrobSetDim);
 			++counter;
 		}
 	}
+
+	// convert count -> offset
+	parallel_exclusive_scan (offsetsOut.begin(), offsetsOut.end(), offsetsOut.begin(), index_t (0));
 }
 
 template <class TIndexVector>
 void FillLowerDimNeighborMap (TIndexVector& nbrMapOut,
                         	   TIndexVector& offsetsOut,
+                        	   const PackedGrobIndex& nbrPacking,
                         	   index_t* grobBaseIndsOut,
                         	   Mesh& mesh,
                         	   GrobSet grobSet,
@@ -152,27 +177,30 @@ void FillLowerDimNeighborMap (TIndexVector& nbrMapOut,
 	FillLowerDimNeighborOffsetMap (offsetsOut, mesh, grobSet, nbrGrobSet);
 
 	nbrMapOut.clear ();
-	nbrMapOut.resize (offsetsOut.back() * 2, NO_GROB);
+	nbrMapOut.resize (offsetsOut.back());
 
-	index_t nbrGrobBaseInds [NUM_GROB_TYPES];
-	GrobHashMap <index_t> nbrGrobToIndexMap;
-	FillGrobToIndexMap (nbrGrobToIndexMap, nbrGrobBaseInds, mesh, nbrGrobSet);
+	const GrobIndexTable nbrTable (mesh, nbrGrobSet);
 
 	index_t counter = 0;
 	VecSet (grobBaseIndsOut, NUM_GROB_TYPES, NO_INDEX);
 	for(auto grobType : grobSet) {
 		grobBaseIndsOut [grobType] = counter;
-		for(auto grob : mesh.grobs (grobType)) {
-			const index_t offset = 2 * offsetsOut [counter];
+		if (!mesh.has (grobType))
+			continue;
+
+		const GrobArray& grobs = mesh.grobs (grobType);
+		const index_t base = counter;
+		parallel_for (index_t (0), grobs.size(), [&] (const index_t igrob) {
+			const Grob grob = grobs [igrob];
+			const index_t offset = offsetsOut [base + igrob];
 			const index_t numNbrs = grob.num_sides (nbrGrobSetDim);
 			
 			for(index_t inbr = 0; inbr < numNbrs; ++inbr) {
-				const Grob nbrGrob = grob.side (nbrGrobSetDim, inbr);
-				nbrMapOut [offset + 2*inbr] = nbrGrob.grob_type();
-				nbrMapOut [offset + 2*inbr + 1] = nbrGrobToIndexMap.at (nbrGrob) - nbrGrobBaseInds [nbrGrob.grob_type()];
+				const GrobIndex nbrGI = nbrTable.grob_index (grob.side (nbrGrobSetDim, inbr));
+				nbrMapOut [offset + inbr] = nbrPacking.pack (nbrGI.grobType, nbrGI.index);
 			}
-			++counter;
-		}
+		});
+		counter += grobs.size();
 	}
 }
 
@@ -180,6 +208,7 @@ void FillLowerDimNeighborMap (TIndexVector& nbrMapOut,
 template <class TIndexVector>
 void FillNeighborMap (TIndexVector& nbrMapOut,
                       TIndexVector& offsetsOut,
+                      const PackedGrobIndex& nbrPacking,
                       index_t* grobBaseIndsOut,
                       Mesh& mesh,
                       GrobSet grobSet,
@@ -189,10 +218,10 @@ void FillNeighborMap (TIndexVector& nbrMapOut,
 	const index_t nbrGrobSetDim = nbrGrobSet.dim();
 
 	if (nbrGrobSetDim > grobSetDim) {
-		FillHigherDimNeighborMap (nbrMapOut, offsetsOut, grobBaseIndsOut, mesh, grobSet, nbrGrobSet);
+		FillHigherDimNeighborMap (nbrMapOut, offsetsOut, nbrPacking, grobBaseIndsOut, mesh, grobSet, nbrGrobSet);
 	}
 	else if (nbrGrobSetDim < grobSetDim) {
-		FillLowerDimNeighborMap (nbrMapOut, offsetsOut, grobBaseIndsOut, mesh, grobSet, nbrGrobSet);
+		FillLowerDimNeighborMap (nbrMapOut, offsetsOut, nbrPacking, grobBaseIndsOut, mesh, grobSet, nbrGrobSet);
 	}
 	else {
 		throw LumeError ("FillNeighborMap: Please use a different overload of 'FillNeighborMap' "
@@ -204,6 +233,7 @@ void FillNeighborMap (TIndexVector& nbrMapOut,
 template <class TIndexVector>
 void FillNeighborMap (TIndexVector& elemMapOut,
                       TIndexVector& offsetsOut,
+                      const PackedGrobIndex& nbrPacking,
                       index_t* grobBaseIndsOut,
                       Mesh& mesh,
                       GrobSet grobSet,
@@ -242,7 +272,7 @@ void FillNeighborMap (TIndexVector& elemMapOut,
 		for(auto grobType : grobSet) {
 			grobBaseIndsOut [grobType] = counter;
 			for(auto grob : mesh.grobs (grobType)) {
-				offsetsOut [counter] = elemMapOut.size() / 2;
+				offsetsOut [counter] = elemMapOut.size();
 				grobHash.clear();
 
 				const index_t numSides = grob.num_sides(linkDim);
@@ -257,8 +287,7 @@ void FillNeighborMap (TIndexVector& elemMapOut,
 							continue;
 
 						if (grobHash.insert (nbrGrob).second) {
-							elemMapOut.push_back (nbrGrobInd.grobType);
-							elemMapOut.push_back (nbrGrobInd.index);
+							elemMapOut.push_back (nbrPacking.pack (nbrGrobInd.grobType, nbrGrobInd.index));
 						}
 					}
 				}
@@ -266,7 +295,7 @@ void FillNeighborMap (TIndexVector& elemMapOut,
 				++counter;
 			}
 		}
-		offsetsOut [counter] = elemMapOut.size() / 2;
+		offsetsOut [counter] = elemMapOut.size();
 	}
 	else {
 		throw LumeError ("linkDim > grobDim currently not supported.");
@@ -42,14 +42,11 @@ public:
 	using const_iterator_t = iterator_t;
 
 	NeighborIndices (const GrobIndex& grobIndex,
-			   		 const Neighborhoods* neighborhoods) :
-		m_grobIndex (grobIndex),
-		m_neighborhoods (neighborhoods)
-	{}
+			   		 const Neighborhoods* neighborhoods);
 	
 	const GrobIndex& center_grob_index () const		{return m_grobIndex;}
 
-	index_t size () const;
+	index_t size () const							{return m_size;}
 	GrobIndex operator [] (const index_t i) const	{return neighbor (i);}
 	GrobIndex neighbor (const index_t i) const;
 
@@ -61,6 +58,8 @@ public:
 private:
 	const GrobIndex			m_grobIndex;
 	const Neighborhoods*	m_neighborhoods;
+	const index_t*			m_first;
+	index_t					m_size;
 };
 
 
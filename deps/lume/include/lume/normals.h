@@ -49,6 +49,21 @@ real_t* TriangleNormal3 (real_t* normalOut,
                          const real_t* c2);
 
 
+///	computes the normal of a single triangle or quadrilateral
+/** For quadrilaterals, the normal is perpendicular to both diagonals. This is
+ * the face normal used by `ComputeFaceVertexNormals3`.
+ *
+ * \param normalOut		array of length 3. The resulting normal will be written to this array.
+ * \param coords		coordinates of all vertices (tuple size 3).
+ * \param corners		array of length `numCorners`. Vertex indices of the corners of the face.
+ * \param numCorners	3 for triangles and 4 for quadrilaterals.
+ */
+real_t* FaceNormal3 (real_t* normalOut,
+                     const real_t* coords,
+                     const index_t* corners,
+                     const index_t numCorners);
+
+
 ///	computes the vertex normals of a mesh and stores them in the specified data array
 void
 ComputeFaceVertexNormals3 (Mesh& meshInOut,
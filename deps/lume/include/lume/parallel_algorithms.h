@@ -0,0 +1,294 @@
+// This file is part of lume, a C++ library for lightweight unstructured meshes
+//
+// Copyright (C) 2018 Sebastian Reiter
+// Copyright (C) 2018 G-CSC, Goethe University Frankfurt
+// Author: Sebastian Reiter <s.b.reiter@gmail.com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __H__lume_parallel_algorithms
+#define __H__lume_parallel_algorithms
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <vector>
+#include "parallel_for.h"
+
+namespace lume {
+
+namespace impl {
+
+template <class T, bool isIter>
+struct deref_or_value_impl {
+};
+
+template <class T>
+struct deref_or_value_impl <T, true> {
+	static auto get (const T& t) -> decltype (*t)	{return *t;}
+};
+
+template <class T>
+struct deref_or_value_impl <T, false> {
+	static const T& get (const T& t)				{return t;}
+};
+
+///	returns `*t` if `t` is an iterator and `t` otherwise
+template <class T>
+auto deref_or_value (const T& t) -> decltype (deref_or_value_impl <T, is_iterator<T>::value>::get (t))
+{
+	return deref_or_value_impl <T, is_iterator<T>::value>::get (t);
+}
+
+}// end of namespace impl
+
+
+///	Reduces a sequence in parallel
+/** Each block of the sequence is reduced by a single thread, starting with
+ * `identity`. The results of all blocks are then combined in the calling thread
+ * in the order of the blocks.
+ *
+ * \code
+ * vector <int> v = {1, 2, 3, 4};
+ * int sum = parallel_reduce (v.begin(), v.end(), 0,
+ *                            [] (int acc, int e) {return acc + e;},
+ *                            [] (int a, int b) {return a + b;});
+ * // sum == 10
+ * \endcode
+ *
+ * \param begin, end	iterators or integers, as in `parallel_for`.
+ * \param identity		neutral element of the reduction.
+ * \param accumulate	`T (T acc, value)`, where value is an entry of the sequence
+ *						for iterators and an integer for integer ranges.
+ * \param combine		`T (T a, T b)`, has to be associative.
+ * \param blockSize		see `parallel_for`.*/
+template <class TRandAccIter1, class TRandAccIter2, class T, class TAccumulate, class TCombine>
+T parallel_reduce (TRandAccIter1 begin,
+                   TRandAccIter2 end,
+                   const T& identity,
+                   const TAccumulate& accumulate,
+                   const TCombine& combine,
+                   const int blockSize = 0)
+{
+	using iter_t = TRandAccIter1;
+
+	const auto len = end - begin;
+	if(len <= 0)
+		return identity;
+
+	const size_t numBlocks = impl::num_blocks (len, blockSize, ThreadPool::current ());
+	std::vector <T> partial (numBlocks, identity);
+
+	parallel_for (size_t (0), numBlocks, [&] (const size_t iblock) {
+		const iter_t b = begin + impl::block_begin (len, numBlocks, iblock);
+		const iter_t e = begin + impl::block_begin (len, numBlocks, iblock + 1);
+		T acc = identity;
+		for(iter_t i = b; i < e; ++i)
+			acc = accumulate (acc, impl::deref_or_value (i));
+		partial [iblock] = acc;
+	}, 1);
+
+	T result = identity;
+	for(const auto& p : partial)
+		result = combine (result, p);
+	return result;
+}
+
+
+///	Computes an exclusive prefix scan in parallel
+/** Writes `init, init+in[0], init+in[0]+in[1], ...` to `out` and returns the
+ * combination of `init` with all entries of the sequence. In-place operation
+ * (`out == first`) is supported.
+ *
+ * Using this method, counts can e.g. be converted to offsets:
+ * \code
+ * vector <index_t> offsets = {2, 3, 1, 0};
+ * parallel_exclusive_scan (offsets.begin(), offsets.end(), offsets.begin(), 0);
+ * // offsets == {0, 2, 5, 6}
+ * \endcode
+ *
+ * \param op	associative binary operation. Defaults to `std::plus`.*/
+template <class TRandAccInIter, class TRandAccOutIter, class T, class TOp = std::plus <T>>
+T parallel_exclusive_scan (TRandAccInIter first,
+                           TRandAccInIter last,
+                           TRandAccOutIter out,
+                           const T init,
+                           const TOp& op = TOp (),
+                           const int blockSize = 0)
+{
+	const auto len = last - first;
+	if(len <= 0)
+		return init;
+
+	const size_t numBlocks = impl::num_blocks (len, blockSize, ThreadPool::current ());
+	std::vector <T> blockOffsets (numBlocks);
+
+//	sum of each block
+	parallel_for (size_t (0), numBlocks, [&] (const size_t iblock) {
+		const size_t b = impl::block_begin (len, numBlocks, iblock);
+		const size_t e = impl::block_begin (len, numBlocks, iblock + 1);
+		T sum = first [b];
+		for(size_t i = b + 1; i < e; ++i)
+			sum = op (sum, first [i]);
+		blockOffsets [iblock] = sum;
+	}, 1);
+
+//	convert block sums to block offsets
+	T total = init;
+	for(auto& o : blockOffsets) {
+		const T sum = o;
+		o = total;
+		total = op (total, sum);
+	}
+
+//	scan inside each block
+	parallel_for (size_t (0), numBlocks, [&] (const size_t iblock) {
+		const size_t b = impl::block_begin (len, numBlocks, iblock);
+		const size_t e = impl::block_begin (len, numBlocks, iblock + 1);
+		T run = blockOffsets [iblock];
+		for(size_t i = b; i < e; ++i) {
+			const T v = first [i];
+			out [i] = run;
+			run = op (run, v);
+		}
+	}, 1);
+
+	return total;
+}
+
+
+namespace impl {
+
+///	merges the sorted runs `src[bounds[i], bounds[i+1])` pairwise into `dst`.
+/** Large merges are split into several independent parts, so that all threads
+ * participate even if only few runs are left.
+ * \returns the bounds of the merged runs.*/
+template <class TSrcIter, class TDstIter, class TCompare>
+std::vector <size_t> merge_runs (TSrcIter src,
+                                 TDstIter dst,
+                                 const std::vector <size_t>& bounds,
+                                 const TCompare& comp,
+                                 const size_t numThreads)
+{
+	struct Part {
+		size_t a0, a1, b0, b1, d;
+	};
+
+	const size_t numRuns = bounds.size() - 1;
+	const size_t numPairs = (numRuns + 1) / 2;
+	const size_t partsPerPair = std::max <size_t> (1, (2 * numThreads) / numPairs);
+
+	std::vector <size_t> newBounds;
+	std::vector <Part> parts;
+	newBounds.reserve (numPairs + 1);
+
+	for(size_t irun = 0; irun < numRuns; irun += 2) {
+		newBounds.push_back (bounds [irun]);
+		const size_t a0 = bounds [irun];
+		const size_t a1 = bounds [irun + 1];
+		const size_t b1 = (irun + 2 <= numRuns) ? bounds [irun + 2] : a1;
+
+	//	split the first run evenly and find the matching split points in the second run
+		size_t prevA = a0, prevB = a1;
+		for(size_t ipart = 1; ipart <= partsPerPair; ++ipart) {
+			size_t curA, curB;
+			if (ipart == partsPerPair) {
+				curA = a1;
+				curB = b1;
+			}
+			else {
+				curA = a0 + ((a1 - a0) * ipart) / partsPerPair;
+				curB = (curA < a1) ?
+				       static_cast <size_t> (std::lower_bound (src + a1, src + b1, src [curA], comp) - src) :
+				       b1;
+				curB = std::max (curB, prevB);
+			}
+			parts.push_back (Part {prevA, curA, prevB, curB, prevA + (prevB - a1)});
+			prevA = curA;
+			prevB = curB;
+		}
+	}
+	newBounds.push_back (bounds.back ());
+
+	parallel_for (parts, [src, dst, &comp] (const Part& p) {
+		std::merge (std::make_move_iterator (src + p.a0), std::make_move_iterator (src + p.a1),
+		            std::make_move_iterator (src + p.b0), std::make_move_iterator (src + p.b1),
+		            dst + p.d, comp);
+	}, 1);
+
+	return newBounds;
+}
+
+}// end of namespace impl
+
+
+///	Sorts a sequence in parallel
+/** Blocks of the sequence are sorted in parallel through `std::sort` and are
+ * then merged in parallel. Requires an additional buffer of the size of the
+ * sequence. The sort is not stable.
+ *
+ * \param comp	strict weak ordering, defaults to `std::less`.*/
+template <class TRandAccIter,
+          class TCompare = std::less <typename std::iterator_traits <TRandAccIter>::value_type>>
+void parallel_sort (TRandAccIter begin, TRandAccIter end, const TCompare& comp = TCompare ())
+{
+	using value_t = typename std::iterator_traits <TRandAccIter>::value_type;
+
+//	blocks smaller than this are not worth the overhead of a parallel sort
+	const size_t minBlockSize = 4096;
+
+	const size_t len = end > begin ? static_cast <size_t> (end - begin) : 0;
+	const size_t numThreads = ThreadPool::current ().num_threads ();
+	const size_t numBlocks = std::min (numThreads, len / minBlockSize);
+
+	if (numBlocks <= 1) {
+		std::sort (begin, end, comp);
+		return;
+	}
+
+	std::vector <size_t> bounds (numBlocks + 1);
+	for(size_t i = 0; i <= numBlocks; ++i)
+		bounds [i] = impl::block_begin (len, numBlocks, i);
+
+	parallel_for (size_t (0), numBlocks, [&] (const size_t iblock) {
+		std::sort (begin + bounds [iblock], begin + bounds [iblock + 1], comp);
+	}, 1);
+
+	std::vector <value_t> buffer (len);
+	bool inBuffer = false;
+	while (bounds.size() > 2) {
+		if (inBuffer)
+			bounds = impl::merge_runs (buffer.begin(), begin, bounds, comp, numThreads);
+		else
+			bounds = impl::merge_runs (begin, buffer.begin(), bounds, comp, numThreads);
+		inBuffer = !inBuffer;
+	}
+
+	if (inBuffer) {
+		parallel_for (size_t (0), len, [&] (const size_t i) {
+			begin [i] = std::move (buffer [i]);
+		});
+	}
+}
+
+}//	end of namespace lume
+
+#endif	//__H__lume_parallel_algorithms
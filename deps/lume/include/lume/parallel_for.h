@@ -28,11 +28,11 @@
 #define __H__lume_parallel_for
 
 #include <algorithm>
+#include <exception>
 #include <functional>
-#include <future>
 #include <iterator>
-#include <thread>
-#include <iostream>
+#include <mutex>
+#include "thread_pool.h"
 
 namespace lume {
 
@@ -78,6 +78,27 @@ struct call_with_ref_or_value {
 		call_with_ref_or_value_impl <T, is_iterator<T>::value>::call (f, t);
 	}
 };
+
+
+///	returns the number of blocks into which a sequence of length `len` is split
+/** See the parameter `blockSize` of `parallel_for`.*/
+template <class TLen>
+size_t num_blocks (const TLen len, const int blockSize, const ThreadPool& pool)
+{
+//	a few blocks per thread allow idle threads to steal work
+	const size_t blocksPerThread = 4;
+	return blockSize ?
+		   std::max <size_t> (1, static_cast<size_t> (len / blockSize)) :
+		   std::min <size_t> (static_cast<size_t> (len),
+		                      blocksPerThread * pool.num_threads());
+}
+
+///	returns the offset of the first entry of block `iblock` if `len` entries are split into `numBlocks` blocks
+inline size_t block_begin (const size_t len, const size_t numBlocks, const size_t iblock)
+{
+	return static_cast <size_t> ((static_cast <unsigned long long> (len) * iblock) / numBlocks);
+}
+
 }// end of namespace impl
 
 
@@ -100,17 +121,20 @@ struct call_with_ref_or_value {
  * // v == {1, 1, 1, 1, 1, 1, 1, 1, 1, 1}
  * \endcode
  *
- * In the code above, as many threads as the hardware supports are used and the
- * iteration squence is cut into corresponding blocks, so that each thread executes
- * a sequential iteration on one block.
+ * In the code above, the iteration sequence is cut into blocks which are
+ * processed by the threads of the current `ThreadPool`, which usually is the
+ * global pool (see `ThreadPool::current`). No threads are started during a call
+ * to `parallel_for`. Idle threads steal blocks from busy threads, and the
+ * calling thread processes blocks while it waits. `parallel_for` may
+ * thus also be called from within `func` (nested parallelism).
  *
- * If, however, the function that you pass to parallel_for does heavy work, or if
+ * If the function that you pass to parallel_for does heavy work, or if
  * the runtime of that function varies depending on the current iterate, you may want
- * to schedule more threads than there are hardware threads. To this end you may
- * specify the size of the blocks, which are processed by one thread. This can
- * be done specifying the optional parameter `blockSize` when calling `parallel_for`.
- * The maximum number of threads will be scheduled so that
- * each thread operates on a block of at least size `blockSize`. An example:
+ * to use smaller blocks. To this end you may specify the size of the blocks,
+ * which are processed as a unit. This can be done specifying the optional
+ * parameter `blockSize` when calling `parallel_for`.
+ * The maximum number of blocks will be scheduled so that
+ * each block has at least size `blockSize`. An example:
  *
  * \code
  * void SomeHeavyFunction (shared_ptr<SomeClass>&);
@@ -119,7 +143,7 @@ struct call_with_ref_or_value {
  * parallel_for (v, &SomeHeavyFunction, 1)
  * \endcode
  *
- * This would start one thread for each entry in `v`.
+ * This would schedule one block for each entry in `v`.
  *
  * \warning when using `parallel_for`, please be aware that serious issues may
  *			arise, if common data-types are accessed during a loop. The following
@@ -149,13 +173,15 @@ struct call_with_ref_or_value {
  *					ones used to define the range.
  *
  * \param blockSize	(optional, default = 0) defines the minimal size of an
- *					iteration block which shall be processed by one thread.
- *					The maximum number of threads will be scheduled so that each
- *					thread operates on a block of the provided sequence which has
- *					at least size `blockSize`. 
+ *					iteration block which shall be processed as a unit.
+ *					The maximum number of blocks will be scheduled so that each
+ *					block of the provided sequence has at least size `blockSize`.
  *					If not specified or 0, the block size will be determined
- *					automatically, so that each hardware thread operates on
- *					one part of the sequence.
+ *					automatically, so that each thread of the pool receives
+ *					a few blocks.
+ *
+ * \note	If `func` throws, the first exception is rethrown in the calling
+ *			thread after all blocks have been processed.
  * \{
  */
 template <class TRandAccIter1, class TRandAccIter2, class TFunc>
@@ -170,12 +196,18 @@ void parallel_for (TRandAccIter1 begin,
 	if(len <= 0)
 		return;
 
-	const size_t numBlocks = blockSize ?
-							 std::max <size_t> (1, static_cast<size_t> (len / blockSize)) :
-							 std::max<int> (1, std::thread::hardware_concurrency());
+	ThreadPool& pool = ThreadPool::current ();
+	const size_t numBlocks = impl::num_blocks (len, blockSize, pool);
+
+	if (numBlocks == 1 || pool.num_threads() == 1) {
+		for (iter_t i = begin; i < end; ++i)
+			impl::call_with_ref_or_value <iter_t>::call (func, i);
+		return;
+	}
 
-	std::vector <std::future<void>> futures;
-	futures.reserve (numBlocks);
+	ThreadPool::TaskGroup	group;
+	std::exception_ptr		error;
+	std::mutex				errorMutex;
 
 	for(size_t iblock = 0; iblock < numBlocks; ++iblock) {
 		const auto restLen = (end - begin);
@@ -183,21 +215,28 @@ void parallel_for (TRandAccIter1 begin,
 		auto blockSize = restLen / restBlocks;
 
 	//	process one additional entry until (blockSize * restBlocks == restLen)
-		if (blockSize * restBlocks < restLen)
+		if (size_t (blockSize) * restBlocks < size_t (restLen))
 			++blockSize;
 
 		auto tend = begin + blockSize;
-		auto f = std::async (std::launch::async,
-	                         [begin, tend, func] () {
-	                          	for (iter_t i = begin; i < tend; ++i)
-	                          		impl::call_with_ref_or_value <iter_t>::call (func, i);
-	                         });
+		pool.submit (group, [begin, tend, &func, &error, &errorMutex] () {
+		                 try {
+		                  	for (iter_t i = begin; i < tend; ++i)
+		                  		impl::call_with_ref_or_value <iter_t>::call (func, i);
+		                 }
+		                 catch (...) {
+		                 	std::lock_guard <std::mutex> lock (errorMutex);
+		                 	if (!error)
+		                 		error = std::current_exception ();
+		                 }
+		             });
 		begin = tend;
-		futures.push_back (std::move(f));
 	}
 
-	for(auto& f : futures)
-		f.wait();
+	pool.wait (group);
+
+	if (error)
+		std::rethrow_exception (error);
 }
 
 
@@ -34,6 +34,38 @@ namespace lume {
 
 class Neighborhoods;
 
+/// Creates the rim of the visible grobs of a grob set
+/** `nbrhds` has to associate the sides in `mesh` (centers) with the grobs of
+ * the considered grob set (neighbors). A side belongs to the rim, if exactly
+ * one of its neighbors is visible.
+ *
+ * Rim grobs are appended to `rimMeshOut`, which shares the coordinates of `mesh`.
+ *
+ * Visibility is evaluated in parallel and rim grobs are written in parallel to
+ * presized grob arrays. `visFunc` thus has to be thread safe.
+ *
+ * \param visFunc		`bool (const GrobIndex& gi)`
+ * \param srcGrobsOut	(optional) Receives the source grob of each rim grob,
+ *						i.e. its visible neighbor in `mesh`. Tuple size is set
+ *						to 2. For each created rim grob (in the order of the
+ *						types in the center grob set of `nbrhds`), the pair
+ *						(source type, source index) is appended. It is filled
+ *						in the same parallel pass which writes the rim grobs.*/
+template <class TVisFunc>
+void CreateRimMesh (Mesh& rimMeshOut,
+                    Mesh& mesh,
+                    const Neighborhoods& nbrhds,
+                    const TVisFunc& visFunc,
+                    IndexArrayAnnex* srcGrobsOut = nullptr);
+
+
+/// Creates the rim of the visible grobs of `grobSet`
+/** Forwards to the template version above. If `nbrhds` is not provided,
+ * the required neighborhoods are computed. `gotRimGrobFunc` is called
+ * sequentially after all rim grobs have been created, in the order of the
+ * created rim grobs.
+ * \note	`visFunc` is called concurrently from several threads.
+ * \{ */
 void CreateRimMesh (SPMesh rimMeshOut,
                     SPMesh mesh,
                     GrobSet grobSet,
@@ -63,8 +95,12 @@ SPMesh CreateRimMesh (SPMesh mesh,
                       GrobSet grobSet,
                       const std::function <void (const GrobIndex& rimGrob, const GrobIndex& srcGrob)>& gotRimGrobFunc,
 					  const Neighborhoods* nbrhds = nullptr);
-
+/** \} */
 
 }//	end of namespace lume
 
+
+// INCLUDE IMPLEMENTATION
+#include "rim_mesh_impl.h"
+
 #endif	//__H__lume_rim_mesh
@@ -0,0 +1,120 @@
+// This file is part of lume, a C++ library for lightweight unstructured meshes
+//
+// Copyright (C) 2018 Sebastian Reiter
+// Copyright (C) 2018 G-CSC, Goethe University Frankfurt
+// Author: Sebastian Reiter <s.b.reiter@gmail.com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __H__lume_rim_mesh_impl
+#define __H__lume_rim_mesh_impl
+
+#include <vector>
+#include "rim_mesh.h"
+#include "neighborhoods.h"
+#include "parallel_algorithms.h"
+
+namespace lume {
+
+template <class TVisFunc>
+void CreateRimMesh (Mesh& rimMeshOut,
+                    Mesh& mesh,
+                    const Neighborhoods& nbrhds,
+                    const TVisFunc& visFunc,
+                    IndexArrayAnnex* srcGrobsOut)
+{
+	rimMeshOut.set_coords (mesh.coords());
+
+	if (srcGrobsOut)
+		srcGrobsOut->set_tuple_size (2);
+
+	std::vector <GrobIndex>	srcGrobs;
+	std::vector <index_t>	rimInds;
+
+	for(auto rimGrobType : nbrhds.center_grob_set ()) {
+		const index_t numGrobs = mesh.num (rimGrobType);
+		if (numGrobs == 0)
+			continue;
+
+	//	find the visible neighbor of each rim grob. Other grobs are marked by NO_GROB.
+		srcGrobs.resize (numGrobs);
+		rimInds.resize (numGrobs);
+		parallel_for (index_t (0), numGrobs, [&] (const index_t i) {
+			GrobIndex visNbr;
+			index_t numVis = 0;
+			for(auto nbr : nbrhds.neighbor_indices (GrobIndex (rimGrobType, i))) {
+				if (visFunc (nbr)) {
+					visNbr = nbr;
+					if (++numVis > 1)
+						break;
+				}
+			}
+
+			if (numVis == 1) {
+				srcGrobs [i] = visNbr;
+				rimInds [i] = 1;
+			}
+			else {
+				srcGrobs [i] = GrobIndex ();
+				rimInds [i] = 0;
+			}
+		});
+
+		const index_t numRimGrobs = parallel_exclusive_scan (rimInds.begin(), rimInds.end(),
+		                                                     rimInds.begin(), index_t (0));
+		if (numRimGrobs == 0)
+			continue;
+
+	//	copy the corners and the source grobs of all rim grobs to their final positions
+		GrobArray& rimGrobs = rimMeshOut.grobs (rimGrobType);
+		const index_t firstRimGrob = rimGrobs.size ();
+		rimGrobs.resize (firstRimGrob + numRimGrobs);
+
+		const index_t numCorners = GrobDesc (rimGrobType).num_corners ();
+		const index_t* corners = mesh.grobs (rimGrobType).raw_ptr ();
+		index_t* rimCorners = rimGrobs.raw_ptr () + firstRimGrob * numCorners;
+
+		index_t* rimSrcGrobs = nullptr;
+		if (srcGrobsOut) {
+			const index_t firstSrcEntry = srcGrobsOut->size ();
+			srcGrobsOut->resize (firstSrcEntry + 2 * numRimGrobs);
+			rimSrcGrobs = srcGrobsOut->raw_ptr () + firstSrcEntry;
+		}
+
+		parallel_for (index_t (0), numGrobs, [&] (const index_t i) {
+			if (srcGrobs [i].grobType == NO_GROB)
+				return;
+			const index_t* src = corners + i * numCorners;
+			index_t* dest = rimCorners + rimInds [i] * numCorners;
+			for(index_t j = 0; j < numCorners; ++j)
+				dest [j] = src [j];
+
+			if (rimSrcGrobs) {
+				rimSrcGrobs [2 * rimInds [i]] = srcGrobs [i].grobType;
+				rimSrcGrobs [2 * rimInds [i] + 1] = srcGrobs [i].index;
+			}
+		});
+	}
+}
+
+}//	end of namespace lume
+
+#endif	//__H__lume_rim_mesh_impl
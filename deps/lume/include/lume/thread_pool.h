@@ -0,0 +1,162 @@
+// This file is part of lume, a C++ library for lightweight unstructured meshes
+//
+// Copyright (C) 2018 Sebastian Reiter
+// Copyright (C) 2018 G-CSC, Goethe University Frankfurt
+// Author: Sebastian Reiter <s.b.reiter@gmail.com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __H__lume_thread_pool
+#define __H__lume_thread_pool
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "types.h"
+
+namespace lume {
+
+///	A persistent pool of worker threads which balances work through work stealing
+/** Each worker owns a task queue. Tasks submitted from a worker are pushed to
+ * its own queue and are processed in LIFO order, tasks submitted from other
+ * threads are pushed to a shared queue. Idle workers steal the oldest tasks
+ * from the queues of other workers.
+ *
+ * Tasks are submitted as members of a `TaskGroup`, whose completion can be
+ * awaited through `wait`. Workers which wait execute arbitrary pending tasks in
+ * the meantime. Tasks may thus submit further tasks and wait for them (nested
+ * parallelism) without blocking the pool. Other threads only execute tasks of
+ * the group they wait for, so that they are never occupied by unrelated work
+ * of other threads. If no suitable task is pending, waiting threads block.
+ *
+ * `parallel_for` uses the pool returned by `current`. This is the process wide
+ * pool returned by `global`, unless the calling thread is a worker of another
+ * pool or selected another pool through a `CurrentScope`. Independent work,
+ * e.g. loading a file in the background, can thus run on a pool of its own,
+ * so that threads waiting for the global pool aren't delayed by it.
+ * The number of threads of the global pool defaults to the number of hardware
+ * threads and can be changed through the environment variable
+ * `LUME_NUM_THREADS` or through `set_num_threads`.
+ *
+ * \note	Tasks must not throw. `parallel_for` catches exceptions of its
+ *			iterations and rethrows them in the calling thread.*/
+class ThreadPool {
+public:
+	using Task = std::function <void ()>;
+
+	///	creates a pool in which `numThreads` threads (including the waiting thread) execute tasks
+	/** `numThreads - 1` worker threads are started. If `numThreads <= 1`, all
+	 * tasks are executed by the thread which waits for them.*/
+	explicit ThreadPool (const index_t numThreads);
+	~ThreadPool ();
+
+	ThreadPool (const ThreadPool&) = delete;
+	ThreadPool& operator = (const ThreadPool&) = delete;
+
+	///	returns the process wide thread pool
+	static ThreadPool& global ();
+
+	///	replaces the process wide thread pool by a pool with the given number of threads
+	/** \warning	must not be called while the global pool is in use.*/
+	static void set_num_threads (const index_t numThreads);
+
+	///	returns the pool which executes parallel work of the calling thread
+	/** This is the pool of the innermost `CurrentScope` of the calling thread,
+	 * the pool of which the calling thread is a worker, or `global`.*/
+	static ThreadPool& current ();
+
+	///	makes a pool the `current` pool of the calling thread during its lifetime
+	class CurrentScope {
+	public:
+		explicit CurrentScope (ThreadPool& pool);
+		~CurrentScope ();
+
+		CurrentScope (const CurrentScope&) = delete;
+		CurrentScope& operator = (const CurrentScope&) = delete;
+
+	private:
+		ThreadPool*	m_previous;
+	};
+
+	///	returns `LUME_NUM_THREADS` if set and valid or the number of hardware threads otherwise.
+	static index_t default_num_threads ();
+
+	///	number of threads which execute tasks, including the thread waiting for them.
+	index_t num_threads () const	{return static_cast <index_t> (m_workers.size()) + 1;}
+
+	///	counts the unfinished tasks which were submitted together (see `submit` and `wait`)
+	class TaskGroup {
+	public:
+		TaskGroup () : m_numOpen (0)	{}
+		TaskGroup (const TaskGroup&) = delete;
+		TaskGroup& operator = (const TaskGroup&) = delete;
+
+		bool done () const	{return m_numOpen == 0;}
+
+	private:
+		friend class ThreadPool;
+		std::atomic <size_t>	m_numOpen;
+	};
+
+	///	schedules a task of the given group for execution by the pool
+	/** `group` has to outlive the execution of the task (see `wait`).*/
+	void submit (TaskGroup& group, Task task);
+
+	///	returns once all tasks of `group` have been executed
+	/** The calling thread executes pending tasks in the meantime. See the
+	 * class description for the tasks which are considered.*/
+	void wait (TaskGroup& group);
+
+private:
+	struct Entry {
+		Task		task;
+		TaskGroup*	group;
+	};
+
+	struct Queue {
+		std::mutex			mutex;
+		std::deque <Entry>	entries;
+	};
+
+	void run (Entry& entry);
+	bool pop_task (Entry& entryOut, const int ownQueue);
+	bool pop_group_task (Entry& entryOut, const TaskGroup& group);
+	int own_queue () const;
+	void worker_main (const int queueIndex);
+
+///	one queue per worker. The last queue receives tasks of external threads.
+	std::vector <std::unique_ptr <Queue>>	m_queues;
+	std::vector <std::thread>				m_workers;
+	std::mutex								m_sleepMutex;
+	std::condition_variable					m_wakeUp;
+	std::condition_variable					m_taskDone;
+	std::atomic <size_t>					m_numPending;
+	bool									m_stop;
+};
+
+}//	end of namespace lume
+
+#endif	//__H__lume_thread_pool
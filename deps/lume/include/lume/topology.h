@@ -47,20 +47,88 @@ namespace impl {
  * indexing schemata are possible. E.g. first indexing all triangles and afterwards
  * all quadrilaterals in a consecutive way (the first quad index is thus equal to
  * the number of triangles). If such an indexing scheme is encountered, this class
- * allows to map those indices to slimesh's indexing scheme.*/
+ * allows to map those indices to slimesh's indexing scheme.
+ *
+ * At most `MAX_GROB_SET_SIZE` grob types are supported. A lookup performs a fixed
+ * number of comparisons and doesn't branch on the grob type.
+ *
+ * The map stores the grob counts of `mesh` at the time of its construction.
+ * It may thus be reused as long as no grobs of the given types are added or removed.*/
 class TotalToGrobIndexMap {
 public:
-	TotalToGrobIndexMap (Mesh& mesh, const GrobSet& gs);
-	TotalToGrobIndexMap (Mesh& mesh, const std::vector <grob_t>& gs);
-	TotalToGrobIndexMap (Mesh& mesh, std::vector <grob_t>&& gs);
+	TotalToGrobIndexMap (const Mesh& mesh, const GrobSet& gs);
+	TotalToGrobIndexMap (const Mesh& mesh, const std::vector <grob_t>& gs);
 
 	GrobIndex operator () (const index_t ind) const;
 
+	/// Maps a whole array of consecutive indices to grob indices
+	/** \param grobIndsOut	array of size `NUM_GROB_TYPES`. For each entry of
+	 *						`totalInds`, the corresponding grob index is appended
+	 *						to `grobIndsOut [grobType]`. The order of entries of
+	 *						`totalInds` is preserved within each grob type.
+	 *
+	 * Throws a LumeError if an index can't be mapped. In this case `grobIndsOut`
+	 * is not modified.*/
+	void map (std::vector <index_t>* grobIndsOut,
+	          const index_t* totalInds,
+	          const index_t numInds) const;
+
+	/// total number of grobs covered by the map
+	index_t size () const	{return m_baseInds [MAX_GROB_SET_SIZE];}
+
 private:
-	void generate_base_inds (Mesh& mesh);
+	void init (const Mesh& mesh, const grob_t* grobTypes, const index_t numGrobTypes);
+
+	/// position of the grob type of `ind` in `m_grobTypes`. `ind` has to be smaller than `size()`
+	index_t rank (const index_t ind) const
+	{
+		index_t r = 0;
+		for(index_t i = 1; i < MAX_GROB_SET_SIZE; ++i)
+			r += index_t (ind >= m_baseInds [i]);
+		return r;
+	}
+
+	index_t	m_baseInds [MAX_GROB_SET_SIZE + 1];
+	grob_t	m_grobTypes [MAX_GROB_SET_SIZE];
+};
+
+
+/// Associates the grobs of a grob set with consecutive indices without hashing
+/** Grobs are indexed in the same way as by `FillGrobToIndexMap`, i.e., type by
+ * type in the order of the types in `grobSet`.
+ *
+ * If `grobSet` is `VERTICES`, a direct vertex indexed table is used. Otherwise
+ * grobs are sorted into buckets by their smallest corner index through a
+ * parallel counting sort. A lookup then compares the canonical key (grob type
+ * and sorted corners) with the few grobs of the corresponding bucket.
+ *
+ * Lookups are thread safe. The table refers to the grobs of `mesh`, which thus
+ * must not be modified during the lifetime of the table.*/
+class GrobIndexTable {
+public:
+	GrobIndexTable (const Mesh& mesh, const GrobSet grobSet);
+
+	/// returns the consecutive index of the given grob or `NO_INDEX` if it is not contained.
+	index_t find (const Grob& grob) const;
 
-	std::vector <index_t>	m_baseInds;
-	std::vector <grob_t>	m_grobTypes;
+	/// returns the GrobIndex of the given grob. Throws a LumeError if it is not contained.
+	GrobIndex grob_index (const Grob& grob) const;
+
+	/// array of size `NUM_GROB_TYPES` holding the first consecutive index of each grob type.
+	const index_t* base_inds () const	{return m_baseInds;}
+
+	index_t size () const				{return m_numGrobs;}
+
+private:
+	GrobIndex to_grob_index (const index_t ind) const;
+	index_t min_corner (const Grob& grob) const;
+
+	const Mesh*				m_mesh;
+	GrobSet					m_grobSet;
+	index_t					m_baseInds [NUM_GROB_TYPES];
+	index_t					m_numGrobs;
+	std::vector <index_t>	m_bucketOffsets;
+	std::vector <index_t>	m_entries;
 };
 
 
@@ -128,8 +196,31 @@ void GrobHashToIndexArray (TIndexVector& indArrayInOut,
 
 
 /// Creates grobs for all sides of the specified dimension
+/** Sides of all grob types of dimension higher than `sideDim` are considered.
+ * Existing grobs of dimension `sideDim` are replaced.*/
 void CreateSideGrobs (Mesh& mesh, const index_t sideDim);
 
+/// Creates grobs for all sides of the grobs in `grobSet` of the specified dimension
+/** Side keys of all grobs are generated in parallel and are distributed to
+ * buckets by (side type, smallest corner) through a parallel counting sort with
+ * atomic bucket counters. Each bucket is then sorted individually, so that
+ * duplicate sides become adjacent. The unique sides are written directly to
+ * the grob arrays of `mesh`, existing grobs of dimension `sideDim` are replaced.
+ *
+ * Each side is created with the orientation of the first grob in `grobSet`
+ * which contains it.
+ *
+ * \param sideIndsOut	(optional) Receives the element to side incidence.
+ *						Tuple size is set to 2. For each grob in `grobSet`
+ *						(in the order of the types in `grobSet`) and for each
+ *						of its sides, the pair (side type, side index) is stored.
+ *
+ * \returns	the number of created sides.*/
+index_t CreateSideGrobs (Mesh& mesh,
+                         const GrobSet grobSet,
+                         const index_t sideDim,
+                         IndexArrayAnnex* sideIndsOut = nullptr);
+
 
 }//	end of namespace lume
 
@@ -54,7 +54,7 @@ void GrobHashToTypeArray (TIndexVector& typeArrayInOut,
 	using iter_t = GrobHash::const_iterator;
 	const iter_t iend = hash.end();
 	for (iter_t igrob = hash.begin(); igrob != iend; ++igrob) {
-		typeArrayInOut.push_back (igrob->grob_type());
+		typeArrayInOut.push_back ((*igrob).grob_type());
 	}
 }
 
@@ -0,0 +1,602 @@
+// This file is part of lume, a C++ library for lightweight unstructured meshes
+//
+// Copyright (C) 2018 Sebastian Reiter
+// Copyright (C) 2018 G-CSC, Goethe University Frankfurt
+// Author: Sebastian Reiter <s.b.reiter@gmail.com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sys/stat.h>
+#include "lume/binary_mesh_file.h"
+#include "lume/file_io.h"
+#include "lume/mapped_file.h"
+#include "lume/parallel_algorithms.h"
+#include "lume/parallel_for.h"
+#include "lume/subset_info_annex.h"
+
+#if defined (__unix__) || defined (__APPLE__)
+	#define LUME_USE_EXCLUSIVE_CREATE
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace lume {
+
+namespace {
+
+const char		BINARY_MESH_MAGIC [8]	= {'l', 'u', 'm', 'e', 'm', 's', 'h', 0};
+const uint32_t	BINARY_MESH_VERSION		= 1;
+const uint32_t	BYTE_ORDER_MARK			= 0x01020304;
+
+enum SectionType : uint32_t {
+	GROB_SECTION		= 1,
+	REAL_ANNEX_SECTION	= 2,
+	INDEX_ANNEX_SECTION	= 3,
+	SUBSET_INFO_SECTION	= 4
+};
+
+struct FileHeader {
+	char		magic [8];
+	uint32_t	version;
+	uint32_t	byteOrderMark;
+	uint32_t	indexSize;
+	uint32_t	realSize;
+	uint64_t	sourceSize;
+	int64_t		sourceModificationTime;
+	uint64_t	sourceContentHash;
+	uint64_t	numSections;
+};
+
+/// each section header is followed by its name and its data, both padded to 8 bytes
+struct SectionHeader {
+	uint32_t	type;
+	uint32_t	grobType;
+	uint32_t	tupleSize;
+	uint32_t	nameSize;
+	uint64_t	dataSize;
+};
+
+struct Section {
+	SectionHeader	header;
+	string			name;
+	const void*		data;
+};
+
+inline uint64_t Padded (const uint64_t size)
+{
+	return (size + 7) & ~uint64_t (7);
+}
+
+inline uint64_t RotateLeft (const uint64_t v, const int r)
+{
+	return (v << r) | (v >> (64 - r));
+}
+
+inline uint64_t HashStep (const uint64_t h, const uint64_t w)
+{
+	return RotateLeft (h ^ (w * 0x87c37b91114253d5ULL), 27) * 0x4cf5ad432745937fULL;
+}
+
+inline uint64_t HashFinalize (uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+uint64_t HashBlock (const char* data, const size_t size, const uint64_t seed)
+{
+	uint64_t h = seed;
+	size_t i = 0;
+	for(; i + 8 <= size; i += 8) {
+		uint64_t w;
+		memcpy (&w, data + i, 8);
+		h = HashStep (h, w);
+	}
+
+	uint64_t w = 0;
+	if (i < size)
+		memcpy (&w, data + i, size - i);
+	return HashFinalize (HashStep (h, w ^ size));
+}
+
+template <class T>
+void AppendToBuffer (string& buf, const T& v)
+{
+	buf.append (reinterpret_cast <const char*> (&v), sizeof (T));
+}
+
+void AppendToBuffer (string& buf, const string& str)
+{
+	AppendToBuffer (buf, uint32_t (str.size()));
+	buf.append (str);
+}
+
+/// Sequential reader of the sections of a memory mapped binary mesh file
+class SectionReader {
+public:
+	SectionReader (const char* data, const size_t size, const string& filename) :
+		m_data (data), m_size (size), m_pos (0), m_filename (filename)
+	{}
+
+	const char* read (const uint64_t numBytes)
+	{
+		if (numBytes > m_size - m_pos)
+			throw FileParseError (string ("Unexpected end of binary mesh file ").append (m_filename));
+		const char* p = m_data + m_pos;
+		m_pos += size_t (Padded (numBytes));
+		m_pos = min (m_pos, m_size);
+		return p;
+	}
+
+	template <class T>
+	T read_value ()
+	{
+		T v;
+		memcpy (&v, read (sizeof (T)), sizeof (T));
+		return v;
+	}
+
+private:
+	const char*	m_data;
+	size_t		m_size;
+	size_t		m_pos;
+	string		m_filename;
+};
+
+/// reads a value of type T from the packed subset info buffer
+template <class T>
+T ReadPacked (const char*& p, const char* end, const string& filename)
+{
+	if (size_t (end - p) < sizeof (T))
+		throw FileParseError (string ("Bad subset info in binary mesh file ").append (filename));
+	T v;
+	memcpy (&v, p, sizeof (T));
+	p += sizeof (T);
+	return v;
+}
+
+string ReadPackedString (const char*& p, const char* end, const string& filename)
+{
+	const uint32_t size = ReadPacked <uint32_t> (p, end, filename);
+	if (size_t (end - p) < size)
+		throw FileParseError (string ("Bad subset info in binary mesh file ").append (filename));
+	string str (p, size);
+	p += size;
+	return str;
+}
+
+FileHeader ReadFileHeader (SectionReader& reader, const string& filename)
+{
+	const FileHeader header = reader.read_value <FileHeader> ();
+	if (memcmp (header.magic, BINARY_MESH_MAGIC, sizeof (BINARY_MESH_MAGIC)) != 0)
+		throw FileParseError (string ("Not a binary mesh file: ").append (filename));
+
+	if (header.version != BINARY_MESH_VERSION
+	    || header.byteOrderMark != BYTE_ORDER_MARK
+	    || header.indexSize != sizeof (index_t)
+	    || header.realSize != sizeof (real_t))
+	{
+		throw FileParseError (string ("Unsupported version or platform of binary mesh file ")
+		                      .append (filename));
+	}
+	return header;
+}
+
+template <class T>
+void CopyToArrayAnnex (ArrayAnnex <T>& annex, const SectionHeader& section,
+                       const char* data, const string& filename)
+{
+	if (section.dataSize % sizeof (T) != 0 || section.tupleSize == 0)
+		throw FileParseError (string ("Bad array section in binary mesh file ").append (filename));
+
+	annex.set_tuple_size (section.tupleSize);
+	annex.resize (index_t (section.dataSize / sizeof (T)));
+	if (section.dataSize > 0)
+		memcpy (annex.raw_ptr (), data, size_t (section.dataSize));
+}
+
+/// Creates a new file with a unique name in the directory of `filename` and returns its name
+/** The name is derived from `filename`, so that the file can replace `filename`
+ * through `rename`. Concurrent writers of the same file thus never share a
+ * temporary file.*/
+string CreateTempFile (const string& filename)
+{
+	static atomic <uint32_t> counter (0);
+
+	for(int attempt = 0; attempt < 100; ++attempt) {
+	#ifdef LUME_USE_EXCLUSIVE_CREATE
+		const string tmpFilename = filename + ".tmp" + to_string (getpid ())
+		                           + "_" + to_string (counter++);
+		const int fd = open (tmpFilename.c_str (), O_WRONLY | O_CREAT | O_EXCL, 0666);
+		if (fd >= 0) {
+			close (fd);
+			return tmpFilename;
+		}
+		if (errno != EEXIST)
+			break;
+	#else
+		const string tmpFilename = filename + ".tmp" + to_string (random_device () ())
+		                           + "_" + to_string (counter++);
+		struct stat st;
+		if (stat (tmpFilename.c_str (), &st) != 0)
+			return tmpFilename;
+	#endif
+	}
+
+	throw FileIOError (string ("Couldn't create a temporary file for ").append (filename));
+}
+
+}// end of unnamed namespace
+
+
+uint64_t HashBytes (const void* data, const size_t size, const uint64_t seed)
+{
+	const size_t blockSize = size_t (1) << 20;
+	const size_t numBlocks = (size + blockSize - 1) / blockSize;
+	const char* bytes = static_cast <const char*> (data);
+
+	if (numBlocks <= 1)
+		return HashBlock (bytes, size, seed);
+
+	vector <uint64_t> blockHashes (numBlocks);
+	parallel_for (size_t (0), numBlocks, [&] (const size_t iblock) {
+		const size_t begin = iblock * blockSize;
+		blockHashes [iblock] = HashBlock (bytes + begin, min (blockSize, size - begin), seed ^ iblock);
+	}, 1);
+
+	return HashBlock (reinterpret_cast <const char*> (blockHashes.data()),
+	                  numBlocks * sizeof (uint64_t), seed ^ size);
+}
+
+
+uint64_t HashFileContents (const std::string& filename)
+{
+	MappedFile file (filename);
+	return HashBytes (file.data(), file.size());
+}
+
+
+uint64_t HashMeshContents (const Mesh& mesh)
+{
+	uint64_t h = 0;
+	for(index_t i = 0; i < NUM_GROB_TYPES; ++i) {
+		const grob_t grobType = grob_t (i);
+		if (!mesh.has (grobType))
+			continue;
+		const IndexArrayAnnex& inds = mesh.grobs (grobType).underlying_array ();
+		h = HashBytes (inds.raw_ptr(), inds.size() * sizeof (index_t), HashStep (h, i));
+	}
+
+	const RealArrayAnnex& coords = *mesh.coords ();
+	h = HashBytes (coords.raw_ptr(), coords.size() * sizeof (real_t), HashStep (h, coords.tuple_size()));
+
+	for(auto iannex = mesh.annex_begin(); iannex != mesh.annex_end(); ++iannex) {
+		if (iannex->first.name == "coords" && iannex->first.grobType == VERTEX)
+			continue;
+
+		const void* data = nullptr;
+		size_t size = 0;
+		index_t tupleSize = 0;
+		if (auto a = dynamic_cast <const RealArrayAnnex*> (iannex->second.get())) {
+			data = a->raw_ptr ();
+			size = a->size () * sizeof (real_t);
+			tupleSize = a->tuple_size ();
+		}
+		else if (auto a = dynamic_cast <const IndexArrayAnnex*> (iannex->second.get())) {
+			data = a->raw_ptr ();
+			size = a->size () * sizeof (index_t);
+			tupleSize = a->tuple_size ();
+		}
+		else
+			continue;
+
+		const string& name = iannex->first.name;
+		h = HashBytes (name.data(), name.size(), HashStep (h, iannex->first.grobType));
+		h = HashBytes (data, size, HashStep (h, tupleSize));
+	}
+
+	return h;
+}
+
+
+FileStamp CreateFileStamp (const std::string& filename, const bool hashContents)
+{
+	struct stat st;
+	if (stat (filename.c_str(), &st) != 0)
+		throw FileNotFoundError (filename);
+
+	FileStamp stamp;
+	stamp.size = uint64_t (st.st_size);
+	stamp.modificationTime = int64_t (st.st_mtime);
+	if (hashContents)
+		stamp.contentHash = HashFileContents (filename);
+	return stamp;
+}
+
+
+void WriteBinaryMeshFile (const Mesh& mesh,
+                          const std::string& filename,
+                          const FileStamp& sourceStamp,
+                          const bool writeCoords)
+{
+	vector <Section> sections;
+	vector <string> buffers;
+	buffers.reserve (distance (mesh.annex_begin(), mesh.annex_end()));
+
+	for(index_t i = 0; i < NUM_GROB_TYPES; ++i) {
+		const grob_t grobType = grob_t (i);
+		if (!mesh.has (grobType))
+			continue;
+		const IndexArrayAnnex& inds = mesh.grobs (grobType).underlying_array ();
+		sections.push_back ({{GROB_SECTION, i, inds.tuple_size(), 0,
+		                      inds.size() * sizeof (index_t)},
+		                     string (), inds.raw_ptr()});
+	}
+
+	for(auto iannex = mesh.annex_begin(); iannex != mesh.annex_end(); ++iannex) {
+		const string& name = iannex->first.name;
+		const uint32_t grobType = uint32_t (iannex->first.grobType);
+		const Annex* annex = iannex->second.get();
+
+		if (!writeCoords && name == "coords" && grobType == VERTEX)
+			continue;
+
+		if (auto a = dynamic_cast <const RealArrayAnnex*> (annex)) {
+			sections.push_back ({{REAL_ANNEX_SECTION, grobType, a->tuple_size(), 0,
+			                      a->size() * sizeof (real_t)},
+			                     name, a->raw_ptr()});
+		}
+		else if (auto a = dynamic_cast <const IndexArrayAnnex*> (annex)) {
+			sections.push_back ({{INDEX_ANNEX_SECTION, grobType, a->tuple_size(), 0,
+			                      a->size() * sizeof (index_t)},
+			                     name, a->raw_ptr()});
+		}
+		else if (auto a = dynamic_cast <const SubsetInfoAnnex*> (annex)) {
+			buffers.push_back (string ());
+			string& buf = buffers.back ();
+			AppendToBuffer (buf, a->name ());
+			AppendToBuffer (buf, uint32_t (a->num_subset_properties ()));
+			for(index_t j = 0; j < a->num_subset_properties (); ++j) {
+				const auto& props = a->subset_properties (j);
+				AppendToBuffer (buf, props.name);
+				for(index_t k = 0; k < 4; ++k)
+					AppendToBuffer (buf, props.color [k]);
+				AppendToBuffer (buf, uint8_t (props.visible));
+			}
+			sections.push_back ({{SUBSET_INFO_SECTION, grobType, 1, 0, buf.size()},
+			                     name, buf.data()});
+		}
+	}
+
+	FileHeader header;
+	memcpy (header.magic, BINARY_MESH_MAGIC, sizeof (BINARY_MESH_MAGIC));
+	header.version = BINARY_MESH_VERSION;
+	header.byteOrderMark = BYTE_ORDER_MARK;
+	header.indexSize = sizeof (index_t);
+	header.realSize = sizeof (real_t);
+	header.sourceSize = sourceStamp.size;
+	header.sourceModificationTime = sourceStamp.modificationTime;
+	header.sourceContentHash = sourceStamp.contentHash;
+	header.numSections = sections.size ();
+
+	const string tmpFilename = CreateTempFile (filename);
+	{
+		ofstream out (tmpFilename, ios::binary | ios::trunc);
+		if (!out) {
+			remove (tmpFilename.c_str ());
+			throw FileIOError (string ("Couldn't open ").append (tmpFilename).append (" for writing"));
+		}
+
+		const char zeros [8] = {0, 0, 0, 0, 0, 0, 0, 0};
+		auto writePadded = [&] (const void* data, const uint64_t size) {
+			if (size > 0)
+				out.write (static_cast <const char*> (data), streamsize (size));
+			out.write (zeros, streamsize (Padded (size) - size));
+		};
+
+		writePadded (&header, sizeof (header));
+		for(auto& s : sections) {
+			s.header.nameSize = uint32_t (s.name.size ());
+			writePadded (&s.header, sizeof (s.header));
+			writePadded (s.name.data (), s.name.size ());
+			writePadded (s.data, s.header.dataSize);
+		}
+
+		out.close ();
+		if (!out) {
+			remove (tmpFilename.c_str ());
+			throw FileIOError (string ("Couldn't write ").append (tmpFilename));
+		}
+	}
+
+//	POSIX rename replaces an existing file atomically. Other systems may
+//	refuse to replace it, in which case the old file is removed first.
+	if (rename (tmpFilename.c_str (), filename.c_str ()) != 0) {
+		remove (filename.c_str ());
+		if (rename (tmpFilename.c_str (), filename.c_str ()) != 0) {
+			remove (tmpFilename.c_str ());
+			throw FileIOError (string ("Couldn't write ").append (filename));
+		}
+	}
+}
+
+
+SPMesh CreateMeshFromBinaryFile (const std::string& filename)
+{
+	MappedFile file (filename);
+	SectionReader reader (file.data(), file.size(), filename);
+	const FileHeader header = ReadFileHeader (reader, filename);
+
+	auto mesh = make_shared <Mesh> ();
+	bool hasCoords = false;
+	for(uint64_t isection = 0; isection < header.numSections; ++isection) {
+		const SectionHeader section = reader.read_value <SectionHeader> ();
+		const string name (reader.read (section.nameSize), section.nameSize);
+		const char* data = reader.read (section.dataSize);
+
+		if (section.grobType >= NUM_GROB_TYPES && section.grobType != NO_GROB)
+			throw FileParseError (string ("Bad grob type in binary mesh file ").append (filename));
+		const grob_t grobType = grob_t (section.grobType);
+
+		switch (section.type) {
+			case GROB_SECTION: {
+				if (grobType == NO_GROB
+				    || section.tupleSize != GrobDesc (grobType).num_corners ())
+				{
+					throw FileParseError (string ("Bad grob section in binary mesh file ")
+					                      .append (filename));
+				}
+				CopyToArrayAnnex (mesh->grobs (grobType).underlying_array (),
+				                  section, data, filename);
+			} break;
+
+			case REAL_ANNEX_SECTION: {
+				auto annex = make_shared <RealArrayAnnex> ();
+				CopyToArrayAnnex (*annex, section, data, filename);
+				mesh->set_annex (name, grobType, annex);
+				if (name == "coords" && grobType == VERTEX)
+					hasCoords = true;
+			} break;
+
+			case INDEX_ANNEX_SECTION: {
+				auto annex = make_shared <IndexArrayAnnex> ();
+				CopyToArrayAnnex (*annex, section, data, filename);
+				mesh->set_annex (name, grobType, annex);
+			} break;
+
+			case SUBSET_INFO_SECTION: {
+				const char* p = data;
+				const char* end = data + section.dataSize;
+				auto subsetInfo = make_shared <SubsetInfoAnnex> (ReadPackedString (p, end, filename));
+				const uint32_t numSubsets = ReadPacked <uint32_t> (p, end, filename);
+				for(uint32_t i = 0; i < numSubsets; ++i) {
+					SubsetInfoAnnex::SubsetProperties props;
+					props.name = ReadPackedString (p, end, filename);
+					for(index_t k = 0; k < 4; ++k)
+						props.color [k] = ReadPacked <real_t> (p, end, filename);
+					props.visible = ReadPacked <uint8_t> (p, end, filename) != 0;
+					subsetInfo->add_subset (std::move (props));
+				}
+				mesh->set_annex (name, grobType, subsetInfo);
+			} break;
+
+			default:
+				throw FileParseError (string ("Unknown section in binary mesh file ").append (filename));
+		}
+	}
+
+//	A truncated or corrupted file must not produce a mesh whose grobs reference
+//	missing vertices or whose annexes don't match its grobs.
+//	Files written without coordinates (see `WriteBinaryMeshFile`) don't define
+//	the number of vertices, so vertex related checks are skipped for those.
+	const index_t numVrts = hasCoords ? mesh->annex <RealArrayAnnex> ("coords", VERTEX)->num_tuples ()
+	                                  : 0;
+	for(index_t i = 0; hasCoords && i < NUM_GROB_TYPES; ++i) {
+		const grob_t grobType = grob_t (i);
+		if (grobType == VERTEX || !mesh->has (grobType))
+			continue;
+		const IndexArrayAnnex& inds = mesh->grobs (grobType).underlying_array ();
+		const index_t* corners = inds.raw_ptr ();
+		const index_t maxCorner = parallel_reduce (corners, corners + inds.size (), index_t (0),
+		                            [] (index_t m, const index_t c) {return max (m, c);},
+		                            [] (const index_t a, const index_t b) {return max (a, b);});
+		if (inds.size () > 0 && maxCorner >= numVrts)
+			throw FileParseError (string ("Bad corner index in binary mesh file ").append (filename));
+	}
+
+	for(auto iannex = mesh->annex_begin(); iannex != mesh->annex_end(); ++iannex) {
+		const grob_t grobType = iannex->first.grobType;
+		auto realAnnex = dynamic_cast <const RealArrayAnnex*> (iannex->second.get());
+		auto indexAnnex = dynamic_cast <const IndexArrayAnnex*> (iannex->second.get());
+		if (grobType == NO_GROB || (grobType == VERTEX && !hasCoords)
+		    || (!realAnnex && !indexAnnex))
+		{
+			continue;
+		}
+
+		const index_t numTuples = realAnnex ? realAnnex->num_tuples () : indexAnnex->num_tuples ();
+		const index_t numGrobs = grobType == VERTEX ? numVrts : mesh->num (grobType);
+		if (numTuples != numGrobs) {
+			throw FileParseError (string ("Annex '").append (iannex->first.name)
+			                      .append ("' doesn't match its grobs in binary mesh file ")
+			                      .append (filename));
+		}
+	}
+
+	return mesh;
+}
+
+
+FileStamp ReadBinaryMeshFileStamp (const std::string& filename)
+{
+	ifstream in (filename, ios::binary);
+	if (!in)
+		throw FileNotFoundError (filename);
+
+	char buf [sizeof (FileHeader)];
+	in.read (buf, sizeof (buf));
+	SectionReader reader (buf, size_t (in.gcount ()), filename);
+	const FileHeader header = ReadFileHeader (reader, filename);
+
+	FileStamp stamp;
+	stamp.size = header.sourceSize;
+	stamp.modificationTime = header.sourceModificationTime;
+	stamp.contentHash = header.sourceContentHash;
+	return stamp;
+}
+
+
+void WriteBinaryMeshFileStamp (const std::string& filename, const FileStamp& stamp)
+{
+	fstream file (filename, ios::in | ios::out | ios::binary);
+	if (!file)
+		throw FileNotFoundError (filename);
+
+	char buf [sizeof (FileHeader)];
+	file.read (buf, sizeof (buf));
+	SectionReader reader (buf, size_t (file.gcount ()), filename);
+	FileHeader header = ReadFileHeader (reader, filename);
+
+	header.sourceSize = stamp.size;
+	header.sourceModificationTime = stamp.modificationTime;
+	header.sourceContentHash = stamp.contentHash;
+
+	file.seekp (0);
+	file.write (reinterpret_cast <const char*> (&header), sizeof (header));
+	file.flush ();
+	if (!file)
+		throw FileIOError (string ("Couldn't write ").append (filename));
+}
+
+}//	end of namespace lume
@@ -25,12 +25,18 @@
 // THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
+#include <cmath>
+#include <cstdint>
 #include <cstring>
+#include <fstream>
 #include <string>
 #include <sstream>
 #include <algorithm>
 #include "lume/annex_table.h"
+#include "lume/binary_mesh_file.h"
 #include "lume/file_io.h"
+#include "lume/mapped_file.h"
+#include "lume/parallel_algorithms.h"
 #include "lume/subset_info_annex.h"
 #include "lume/vec_math_raw.h"
 #include "lume/topology.h"
@@ -38,14 +44,21 @@
 #include "stl_reader/stl_reader.h"
 #include "rapidxml/rapidxml.hpp"
 
-// disables warnings generated for strtok through MSVC
-#pragma warning(disable:4996)
-
 using namespace std;
 using namespace rapidxml;
 
 namespace lume {
 
+/// passes the progress to the optional callback and throws a LoadCancelledError if it requests cancellation
+static void ReportProgress (const LoadProgressCallback& progress,
+                            const char* phase,
+                            const uint64_t bytesDone,
+                            const uint64_t bytesTotal)
+{
+	if (progress && !progress (phase, bytesDone, bytesTotal))
+		throw LoadCancelledError (string ("Loading was cancelled while ").append (phase));
+}
+
 std::shared_ptr <Mesh> CreateMeshFromSTL (std::string filename)
 {
 	auto mesh = make_shared <Mesh> ();
@@ -201,24 +214,234 @@ std::shared_ptr <Mesh> CreateMeshFromELE(std::string filename)
 	return mesh;
 }
 
-static void ReadIndicesToArrayAnnex (IndexArrayAnnex& indsOut, xml_node<>* node)
+static inline bool IsSpace (const char c)
+{
+	return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+/// parses a non-negative integer from the token starting at `p`. Returns false if the token is invalid.
+static inline bool ParseIndexToken (index_t& valOut, const char*& p)
+{
+	const char* first = p;
+	index_t v = 0;
+	while (*p >= '0' && *p <= '9') {
+		v = v * 10 + index_t (*p - '0');
+		++p;
+	}
+	valOut = v;
+	return p != first && (*p == 0 || IsSpace (*p));
+}
+
+/// parses a decimal floating point number from the token starting at `p`. Returns false if the token is invalid.
+/** The number is parsed independently of the current locale. The significand
+ * is collected in a 64 bit integer and scaled by a power of ten. If both are
+ * exactly representable as double, the result is correctly rounded.*/
+static inline bool ParseRealToken (real_t& valOut, const char*& p)
+{
+	static const double exactPowersOfTen[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+	const bool negative = (*p == '-');
+	if (*p == '-' || *p == '+')
+		++p;
+
+	uint64_t significand = 0;
+	int numDigits = 0;
+	int exponent = 0;
+	bool anyDigit = false;
+
+	for(; *p >= '0' && *p <= '9'; ++p) {
+		anyDigit = true;
+		if (numDigits < 19) {
+			significand = significand * 10 + uint64_t (*p - '0');
+			if (significand) ++numDigits;
+		}
+		else
+			++exponent;
+	}
+
+	if (*p == '.') {
+		++p;
+		for(; *p >= '0' && *p <= '9'; ++p) {
+			anyDigit = true;
+			if (numDigits < 19) {
+				significand = significand * 10 + uint64_t (*p - '0');
+				if (significand) ++numDigits;
+				--exponent;
+			}
+		}
+	}
+
+	if (!anyDigit)
+		return false;
+
+	if (*p == 'e' || *p == 'E') {
+		++p;
+		const bool negativeExp = (*p == '-');
+		if (*p == '-' || *p == '+')
+			++p;
+		if (!(*p >= '0' && *p <= '9'))
+			return false;
+		int e = 0;
+		for(; *p >= '0' && *p <= '9'; ++p) {
+			if (e < 100000)
+				e = e * 10 + (*p - '0');
+		}
+		exponent += negativeExp ? -e : e;
+	}
+
+	if (!(*p == 0 || IsSpace (*p)))
+		return false;
+
+	double v = double (significand);
+	if (significand < (uint64_t (1) << 53) && exponent >= -22 && exponent <= 22)
+		v = (exponent >= 0) ? v * exactPowersOfTen [exponent] : v / exactPowersOfTen [-exponent];
+	else if (significand != 0)
+		v = v * pow (10.0, double (exponent));
+
+	valOut = real_t (negative ? -v : v);
+	return true;
+}
+
+/// Reports the progress of parsing a file in situ through the position of the parsed data
+/** A default constructed instance doesn't report anything.*/
+class InSituProgress {
+public:
+	InSituProgress () : m_progress (nullptr), m_fileBegin (nullptr), m_fileSize (0)	{}
+
+	InSituProgress (const LoadProgressCallback& progress, const char* fileBegin, const uint64_t fileSize) :
+		m_progress (&progress), m_fileBegin (fileBegin), m_fileSize (fileSize)
+	{}
+
+	/// has to be called on the loading thread. Throws a LoadCancelledError on cancellation.
+	void report (const char* pos) const
+	{
+		if (m_progress)
+			ReportProgress (*m_progress, "parsing", uint64_t (pos - m_fileBegin), m_fileSize);
+	}
+
+private:
+	const LoadProgressCallback*	m_progress;
+	const char*					m_fileBegin;
+	uint64_t					m_fileSize;
+};
+
+/// Parses all whitespace separated numbers in the value of `node` and appends them to `valsInOut`
+/** Tokens are counted first, so that `valsInOut` is resized exactly once. Large
+ * ranges are split into chunks at whitespace, which are counted and parsed
+ * concurrently. Chunks are parsed in waves of one chunk per thread. The
+ * progress is reported after each wave, so that parsing of large values can
+ * be cancelled.
+ *
+ * \param parseToken	`bool (T& valOut, const char*& p)`. Parses the token at `p`
+ *						and advances `p` behind it. Returns false for invalid tokens.*/
+template <class TVector, class TParseToken>
+static void ParseNumbers (TVector& valsInOut,
+                          xml_node<>* node,
+                          const TParseToken& parseToken,
+                          const InSituProgress& progress = InSituProgress ())
 {
-	char* p = strtok (node->value(), " ");
-	while (p) {
-		indsOut.push_back (atoi(p));
-		p = strtok (nullptr, " ");
+	const char* begin = node->value();
+	const char* end = begin + node->value_size();
+	const size_t len = size_t (end - begin);
+	const size_t minChunkSize = size_t (1) << 20;
+	const size_t maxChunkSize = size_t (1) << 24;
+	const size_t numThreads = ThreadPool::current().num_threads();
+	const size_t chunksPerWave = numThreads;
+	const size_t numChunks = max (max <size_t> (1, min (len / minChunkSize, 4 * numThreads)),
+	                              (len + maxChunkSize - 1) / maxChunkSize);
+
+//	chunks start at whitespace, so that no token is split
+	vector <const char*> chunks (numChunks + 1);
+	chunks [0] = begin;
+	chunks [numChunks] = end;
+	for(size_t i = 1; i < numChunks; ++i) {
+		const char* c = max (chunks [i - 1], begin + len * i / numChunks);
+		while (c < end && !IsSpace (*c))
+			++c;
+		chunks [i] = c;
+	}
+
+	vector <index_t> offsets (numChunks + 1, 0);
+	parallel_for (size_t (0), numChunks, [&] (const size_t ichunk) {
+		index_t numTokens = 0;
+		bool inToken = false;
+		for(const char* c = chunks [ichunk]; c < chunks [ichunk + 1]; ++c) {
+			const bool space = IsSpace (*c);
+			numTokens += index_t (inToken == space && !space);
+			inToken = !space;
+		}
+		offsets [ichunk] = numTokens;
+	}, 1);
+	progress.report (begin);
+
+	const index_t oldSize = index_t (valsInOut.size());
+	const index_t numTokens = parallel_exclusive_scan (offsets.begin(), offsets.end(),
+	                                                   offsets.begin(), oldSize) - oldSize;
+	if (numTokens == 0)
+		return;
+
+	valsInOut.resize (oldSize + numTokens);
+	auto* vals = &valsInOut [0];
+	auto parseChunk = [&] (const size_t ichunk) {
+		const char* c = chunks [ichunk];
+		const char* chunkEnd = chunks [ichunk + 1];
+		index_t i = offsets [ichunk];
+		while (true) {
+			while (c < chunkEnd && IsSpace (*c))
+				++c;
+			if (c >= chunkEnd)
+				break;
+
+			const char* token = c;
+			if (!parseToken (vals [i], c) || c > chunkEnd) {
+				const char* tokenEnd = token;
+				while (tokenEnd < end && !IsSpace (*tokenEnd))
+					++tokenEnd;
+				throw FileParseError (string ("Invalid number '").
+				                      append (token, min <size_t> (tokenEnd - token, 32)).
+				                      append ("' in element '").append (node->name()).
+				                      append ("'"));
+			}
+			++i;
+		}
+	};
+
+	for(size_t firstChunk = 0; firstChunk < numChunks; firstChunk += chunksPerWave) {
+		const size_t lastChunk = min (numChunks, firstChunk + chunksPerWave);
+		parallel_for (firstChunk, lastChunk, parseChunk, 1);
+		progress.report (chunks [lastChunk]);
 	}
 }
 
-static SubsetInfoAnnex::Color ParseColor (char* colStr)
+static void ReadIndicesToArrayAnnex (IndexArrayAnnex& indsOut,
+                                     xml_node<>* node,
+                                     const InSituProgress& progress)
+{
+	ParseNumbers (indsOut, node, ParseIndexToken, progress);
+}
+
+static void ReadRealsToArrayAnnex (RealArrayAnnex& valsOut,
+                                   xml_node<>* node,
+                                   const InSituProgress& progress)
+{
+	ParseNumbers (valsOut, node, ParseRealToken, progress);
+}
+
+static SubsetInfoAnnex::Color ParseColor (const char* colStr)
 {
-	char* p = strtok (colStr, " ");
-	int i = 0;
 	SubsetInfoAnnex::Color col (1.f);
-	while (p && i < 4) {
-		col [i] = real_t (atof(p));
-		p = strtok (nullptr, " ");
-		++i;
+	const char* p = colStr;
+	for(int i = 0; i < 4; ++i) {
+		while (IsSpace (*p))
+			++p;
+		if (*p == 0)
+			break;
+		real_t v;
+		if (!ParseRealToken (v, p))
+			throw FileParseError (string ("Invalid color '").append (colStr).append ("'"));
+		col [i] = v;
 	}
 	return col;
 }
@@ -242,66 +465,70 @@ static void ParseElementIndicesToArrayAnnex (SPMesh& mesh,
                                             const string& annexName,
                                             xml_node<>* node,
                                             const T value,
-                                            const GrobSet& gs)
+                                            const GrobSet& gs,
+                                            const TotalToGrobIndexMap& indMap,
+                                            const InSituProgress& progress)
 {
 	if (!node) return;
 	
 	// indices in the node are referring to all elements of one dimension.
 	// we have to map them to indices of individual grob types.
-	TotalToGrobIndexMap indMap (*mesh, UGXGrobTypeArrayFromGrobSet (gs));
+	vector <index_t> totalInds;
+	ParseNumbers (totalInds, node, ParseIndexToken, progress);
+
+	vector <index_t> grobInds [NUM_GROB_TYPES];
+	indMap.map (grobInds, totalInds.data(), index_t (totalInds.size()));
 
 	ArrayAnnexTable <ArrayAnnex<T>> annexTable (mesh, annexName, gs, true);
 	annexTable.resize_annexes_to_match_grobs (1);
 
-	// parse the node values and assign indices
-	char* p = strtok (node->value(), " ");
-	while (p) {
-		const auto ig = indMap (index_t (atoi(p)));
-		annexTable [ig] = value;
-		p = strtok (nullptr, " ");
+	for(auto grobType : gs) {
+		if (grobInds [grobType].empty())
+			continue;
+		auto& annex = *annexTable.annex (grobType);
+		for(auto i : grobInds [grobType])
+			annex [i] = value;
 	}
 }
 
+/// `indMaps` holds one map for each dimension, see `CreateUGXIndexMaps`
 template <class T>
 static void ParseElementIndicesToArrayAnnex (SPMesh& mesh,
                                             const string& annexName,
                                             xml_node<>* node,
-                                            const T value)
+                                            const T value,
+                                            const vector <TotalToGrobIndexMap>& indMaps,
+                                            const InSituProgress& progress)
 {
-	ParseElementIndicesToArrayAnnex (mesh, annexName, node->first_node ("vertices"), value, VERTICES);
-	ParseElementIndicesToArrayAnnex (mesh, annexName, node->first_node ("edges"), value, EDGES);
-	ParseElementIndicesToArrayAnnex (mesh, annexName, node->first_node ("faces"), value, FACES);
-	ParseElementIndicesToArrayAnnex (mesh, annexName, node->first_node ("volumes"), value, CELLS);
+	ParseElementIndicesToArrayAnnex (mesh, annexName, node->first_node ("vertices"), value, VERTICES, indMaps[0], progress);
+	ParseElementIndicesToArrayAnnex (mesh, annexName, node->first_node ("edges"), value, EDGES, indMaps[1], progress);
+	ParseElementIndicesToArrayAnnex (mesh, annexName, node->first_node ("faces"), value, FACES, indMaps[2], progress);
+	ParseElementIndicesToArrayAnnex (mesh, annexName, node->first_node ("volumes"), value, CELLS, indMaps[3], progress);
 }
 
-
-std::shared_ptr <Mesh> CreateMeshFromUGX (std::string filename)
+static vector <TotalToGrobIndexMap> CreateUGXIndexMaps (const Mesh& mesh)
 {
-	xml_document<> doc;
-	char* fileContent = nullptr;
-
-	{
-		ifstream in(filename, ios::binary);
-		if (!in)
-			throw FileNotFoundError (filename);
-
-	//	get the length of the file
-		streampos posStart = in.tellg();
-		in.seekg(0, ios_base::end);
-		streampos posEnd = in.tellg();
-		streamsize size = posEnd - posStart;
+	vector <TotalToGrobIndexMap> indMaps;
+	indMaps.reserve (4);
+	for(auto gs : {VERTICES, EDGES, FACES, CELLS})
+		indMaps.emplace_back (mesh, UGXGrobTypeArrayFromGrobSet (GrobSet (gs)));
+	return indMaps;
+}
 
-	//	go back to the start of the file
-		in.seekg(posStart);
 
-	//	read the whole file en-block and terminate it with 0
-		fileContent = doc.allocate_string(0, size + 1);
-		in.read(fileContent, size);
-		fileContent[size] = 0;
-		in.close();
-	}
+std::shared_ptr <Mesh> CreateMeshFromUGX (std::string filename,
+                                          const LoadProgressCallback& progress)
+{
+	MappedFile file (filename);
 
-	doc.parse<0>(fileContent);
+//	rapidxml parses in situ and writes terminating zeros behind names and values.
+//	Only the pages of the private mapping which receive such a zero are copied.
+//	It only locates the nodes and can't report progress. The numbers in the
+//	values of the nodes are converted by ParseNumbers below, which reports the
+//	progress and may be cancelled.
+	xml_document<> doc;
+	doc.parse<0>(file.data());
+	const InSituProgress inSituProgress (progress, file.data(), file.size());
 
 	xml_node<>* gridNode = doc.first_node("grid");
 	if (!gridNode)
@@ -314,6 +541,8 @@ std::shared_ptr <Mesh> CreateMeshFromUGX (std::string filename)
 	xml_node<>* curNode = gridNode->first_node();
 	for(;curNode; curNode = curNode->next_sibling()) {
 		const char* name = curNode->name();
+	//	names are stored in situ, so that their position reflects the progress
+		inSituProgress.report (name);
 
 		if(strcmp(name, "vertices") == 0 || strcmp(name, "constrained_vertices") == 0)
 		{
@@ -332,47 +561,41 @@ std::shared_ptr <Mesh> CreateMeshFromUGX (std::string filename)
 			lastNumSrcCoords = numSrcCoords;
 			coords.set_tuple_size (numSrcCoords);
 			
-		//	create a buffer with which we can access the data
-			char* p = strtok (curNode->value(), " ");
-			while (p) {
-			//	read the data
-				coords.push_back (real_t (atof(p)));
-				p = strtok (nullptr, " ");
-			}
+			ReadRealsToArrayAnnex (coords, curNode, inSituProgress);
 		}
 
 		else if(strcmp(name, "edges") == 0
 		        || strcmp(name, "constraining_edges") == 0
 		        || strcmp(name, "constrained_edges") == 0)
 		{
-			ReadIndicesToArrayAnnex (mesh->grobs (EDGE).underlying_array (), curNode);
+			ReadIndicesToArrayAnnex (mesh->grobs (EDGE).underlying_array (), curNode, inSituProgress);
 		}
 
 		else if(strcmp(name, "triangles") == 0
 		        || strcmp(name, "constraining_triangles") == 0
 		        || strcmp(name, "constrained_triangles") == 0)
 		{
-			ReadIndicesToArrayAnnex (mesh->grobs (TRI).underlying_array (), curNode);
+			ReadIndicesToArrayAnnex (mesh->grobs (TRI).underlying_array (), curNode, inSituProgress);
 		}
 
 		else if(strcmp(name, "quadrilaterals") == 0
 		        || strcmp(name, "constraining_quadrilaterals") == 0
 		        || strcmp(name, "constrained_quadrilaterals") == 0)
 		{
-			ReadIndicesToArrayAnnex (mesh->grobs (QUAD).underlying_array (), curNode);
+			ReadIndicesToArrayAnnex (mesh->grobs (QUAD).underlying_array (), curNode, inSituProgress);
 		}
 
 		else if(strcmp(name, "tetrahedrons") == 0)
-			ReadIndicesToArrayAnnex (mesh->grobs (TET).underlying_array (), curNode);
+			ReadIndicesToArrayAnnex (mesh->grobs (TET).underlying_array (), curNode, inSituProgress);
 
 		else if(strcmp(name, "hexahedrons") == 0)
-			ReadIndicesToArrayAnnex (mesh->grobs (HEX).underlying_array (), curNode);
+			ReadIndicesToArrayAnnex (mesh->grobs (HEX).underlying_array (), curNode, inSituProgress);
 
 		else if(strcmp(name, "pyramids") == 0)
-			ReadIndicesToArrayAnnex (mesh->grobs (PYRA).underlying_array (), curNode);
+			ReadIndicesToArrayAnnex (mesh->grobs (PYRA).underlying_array (), curNode, inSituProgress);
 
 		else if(strcmp(name, "prisms") == 0)
-			ReadIndicesToArrayAnnex (mesh->grobs (PRISM).underlying_array (), curNode);
+			ReadIndicesToArrayAnnex (mesh->grobs (PRISM).underlying_array (), curNode, inSituProgress);
 
 		// else if(strcmp(name, "octahedrons") == 0)
 		// 	bSuccess = create_octahedrons(volumes, grid, curNode, vertices);
@@ -385,6 +608,8 @@ std::shared_ptr <Mesh> CreateMeshFromUGX (std::string filename)
 			if (xml_attribute<>* attrib = curNode->first_attribute("name"))
 				siName = attrib->value();
 
+			const auto indMaps = CreateUGXIndexMaps (*mesh);
+
 			SPSubsetInfoAnnex subsetInfo = make_shared <SubsetInfoAnnex> (siName);
 			subsetInfo->add_subset (SubsetInfoAnnex::SubsetProperties ());
 
@@ -397,7 +622,7 @@ std::shared_ptr <Mesh> CreateMeshFromUGX (std::string filename)
 				if (xml_attribute<>* attrib = subsetNode->first_attribute("color"))
 					props.color = ParseColor (attrib->value());
 
-				ParseElementIndicesToArrayAnnex (mesh, siName, subsetNode, subsetIndex);
+				ParseElementIndicesToArrayAnnex (mesh, siName, subsetNode, subsetIndex, indMaps, inSituProgress);
 
 				subsetInfo->add_subset (std::move (props));
 				++subsetIndex;
@@ -420,11 +645,553 @@ std::shared_ptr <Mesh> CreateMeshFromUGX (std::string filename)
 }
 
 
-std::shared_ptr <Mesh> CreateMeshFromFile (std::string filename)
+namespace {
+
+/// Reads the tags and the text of an xml file sequentially through a window of fixed size
+/** Only the features of xml which are used by ugx files are supported.
+ * Processing instructions, comments, CDATA sections and doctype declarations
+ * are skipped. Memory consumption is independent of the size of the file.*/
+class XMLStreamReader {
+public:
+	enum Event {START_TAG, END_TAG, END_OF_FILE};
+
+	/// \param progress	(optional) is called whenever the window is refilled
+	XMLStreamReader (const string& filename, const size_t windowSize,
+	                 const LoadProgressCallback& progress = LoadProgressCallback ()) :
+		m_filename (filename),
+		m_in (filename, ios::binary | ios::ate),
+		m_window (windowSize),
+		m_pos (0),
+		m_end (0),
+		m_fileSize (0),
+		m_bytesRead (0),
+		m_progress (progress),
+		m_pendingEndTag (false)
+	{
+		if (!m_in)
+			throw FileNotFoundError (filename);
+		m_fileSize = uint64_t (m_in.tellg ());
+		m_in.seekg (0);
+	}
+
+	/// name of the current tag
+	const string& name () const	{return m_name;}
+
+	/// returns the value of the given attribute of the current start tag or nullptr
+	const char* attribute (const char* attribName) const
+	{
+		for(auto& a : m_attribs) {
+			if (a.first == attribName)
+				return a.second.c_str();
+		}
+		return nullptr;
+	}
+
+	/// advances to the next start or end tag. Text in between is skipped.
+	/** A self closing tag is reported as a START_TAG followed by an END_TAG.*/
+	Event next ()
+	{
+		if (m_pendingEndTag) {
+			m_pendingEndTag = false;
+			return END_TAG;
+		}
+
+		while (true) {
+			int c;
+			while ((c = get ()) != '<') {
+				if (c == EOF)
+					return END_OF_FILE;
+			}
+
+			c = peek ();
+			if (c == '?')
+				skip_past ("?>");
+			else if (c == '!') {
+				get ();
+				if (peek () == '-')
+					skip_past ("-->");
+				else if (peek () == '[')
+					skip_past ("]]>");
+				else
+					skip_past (">");
+			}
+			else if (c == '/') {
+				get ();
+				read_name (m_name);
+				skip_past (">");
+				return END_TAG;
+			}
+			else {
+				read_start_tag ();
+				return START_TAG;
+			}
+		}
+	}
+
+	/// skips all contents of the element whose start tag was just read, including its end tag
+	void skip_element ()
+	{
+		int depth = 1;
+		while (depth > 0) {
+			switch (next ()) {
+				case START_TAG:	++depth; break;
+				case END_TAG:	--depth; break;
+				default:		throw error ("Unexpected end of file");
+			}
+		}
+	}
+
+	/// calls `func (const char* token)` for each whitespace separated token of the text behind the current start tag
+	/** Tokens are zero terminated. Reading stops in front of the next tag.*/
+	template <class TFunc>
+	void for_each_token (const TFunc& func)
+	{
+		if (m_pendingEndTag)
+			return;
+
+		char token [64];
+		while (true) {
+			int c = peek ();
+			while (c != EOF && IsSpace (char (c))) {
+				++m_pos;
+				c = peek ();
+			}
+
+			if (c == EOF || c == '<')
+				return;
+
+			size_t len = 0;
+			while (c != EOF && c != '<' && !IsSpace (char (c))) {
+				if (len + 1 == sizeof (token)) {
+					token [len] = 0;
+					throw error (string ("Invalid number '").append (token).
+					             append ("' in element '").append (m_name).append ("'"));
+				}
+				token [len++] = char (c);
+				++m_pos;
+				c = peek ();
+			}
+			token [len] = 0;
+			func (token);
+		}
+	}
+
+	FileParseError error (const string& msg) const
+	{
+		return FileParseError (string (msg).append (" in ").append (m_filename));
+	}
+
+private:
+	int peek ()
+	{
+		if (m_pos == m_end) {
+			ReportProgress (m_progress, "parsing", m_bytesRead, m_fileSize);
+			m_in.read (m_window.data(), streamsize (m_window.size()));
+			m_pos = 0;
+			m_end = size_t (m_in.gcount ());
+			m_bytesRead += m_end;
+			if (m_end == 0)
+				return EOF;
+		}
+		return static_cast <unsigned char> (m_window [m_pos]);
+	}
+
+	int get ()
+	{
+		const int c = peek ();
+		if (c != EOF)
+			++m_pos;
+		return c;
+	}
+
+	void skip_spaces ()
+	{
+		int c = peek ();
+		while (c != EOF && IsSpace (char (c))) {
+			++m_pos;
+			c = peek ();
+		}
+	}
+
+	void skip_past (const char* pattern)
+	{
+		const size_t len = strlen (pattern);
+		char last [4] = {0, 0, 0, 0};
+		while (true) {
+			const int c = get ();
+			if (c == EOF)
+				throw error ("Unexpected end of file");
+			memmove (last, last + 1, len - 1);
+			last [len - 1] = char (c);
+			if (memcmp (last, pattern, len) == 0)
+				return;
+		}
+	}
+
+	void read_name (string& nameOut)
+	{
+		nameOut.clear ();
+		int c = peek ();
+		while (c != EOF && c != '>' && c != '/' && c != '=' && !IsSpace (char (c))) {
+			nameOut.push_back (char (c));
+			++m_pos;
+			c = peek ();
+		}
+	}
+
+	void read_start_tag ()
+	{
+		read_name (m_name);
+		m_attribs.clear ();
+
+		while (true) {
+			skip_spaces ();
+			int c = get ();
+			if (c == '>')
+				return;
+
+			if (c == '/') {
+				if (get () != '>')
+					throw error (string ("Malformed tag '").append (m_name).append ("'"));
+				m_pendingEndTag = true;
+				return;
+			}
+
+			if (c == EOF)
+				throw error ("Unexpected end of file");
+
+			string attribName (1, char (c));
+			string nameRest;
+			read_name (nameRest);
+			attribName.append (nameRest);
+
+			skip_spaces ();
+			if (get () != '=')
+				throw error (string ("Malformed attribute '").append (attribName).append ("'"));
+			skip_spaces ();
+
+			const int quote = get ();
+			if (quote != '"' && quote != '\'')
+				throw error (string ("Malformed attribute '").append (attribName).append ("'"));
+
+			string value;
+			while ((c = get ()) != quote) {
+				if (c == EOF)
+					throw error ("Unexpected end of file");
+				value.push_back (char (c));
+			}
+
+			m_attribs.emplace_back (std::move (attribName), DecodeEntities (value));
+		}
+	}
+
+	static string DecodeEntities (const string& str)
+	{
+		if (str.find ('&') == string::npos)
+			return str;
+
+		static const pair <const char*, char> entities[] = {
+			{"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}, {"&apos;", '\''}};
+
+		string decoded;
+		for(size_t i = 0; i < str.size();) {
+			bool replaced = false;
+			if (str [i] == '&') {
+				for(auto& e : entities) {
+					const size_t len = strlen (e.first);
+					if (str.compare (i, len, e.first) == 0) {
+						decoded.push_back (e.second);
+						i += len;
+						replaced = true;
+						break;
+					}
+				}
+			}
+			if (!replaced)
+				decoded.push_back (str [i++]);
+		}
+		return decoded;
+	}
+
+	string						m_filename;
+	ifstream					m_in;
+	vector <char>				m_window;
+	size_t						m_pos;
+	size_t						m_end;
+	uint64_t					m_fileSize;
+	uint64_t					m_bytesRead;
+	LoadProgressCallback		m_progress;
+	string						m_name;
+	vector <pair <string, string>>	m_attribs;
+	bool						m_pendingEndTag;
+};
+
+}// end of unnamed namespace
+
+
+/// Appends the numbers of the text of the current element of `reader` to `valsInOut`
+template <class T, class TParseToken>
+static void StreamNumbersToArrayAnnex (ArrayAnnex <T>& valsInOut,
+                                       XMLStreamReader& reader,
+                                       const TParseToken& parseToken)
+{
+	reader.for_each_token ([&] (const char* token) {
+		T val;
+		if (!parseToken (val, token))
+			throw reader.error (string ("Invalid number '").append (token).
+			                    append ("' in element '").append (reader.name()).append ("'"));
+		valsInOut.push_back (val);
+	});
+}
+
+
+/// Reads ugx files without building a document tree
+/** The file is read sequentially through a window of `windowSize` bytes. Numbers
+ * are parsed and written to the mesh directly, so that memory consumption
+ * apart from the mesh itself is independent of the file size.*/
+static std::shared_ptr <Mesh> CreateMeshFromUGXStream (const std::string& filename,
+                                                       const size_t windowSize,
+                                                       const LoadProgressCallback& progress)
+{
+	XMLStreamReader reader (filename, windowSize, progress);
+
+	XMLStreamReader::Event event;
+	while ((event = reader.next ()) == XMLStreamReader::START_TAG
+	       && reader.name () != "grid")
+	{
+		reader.skip_element ();
+	}
+
+	if (event != XMLStreamReader::START_TAG)
+		throw FileParseError (string ("no grid found in ") + filename);
+
+	auto mesh = make_shared <Mesh> ();
+	auto& coords = *mesh->coords();
+
+	int lastNumSrcCoords = -1;
+	while ((event = reader.next ()) == XMLStreamReader::START_TAG) {
+		const string& name = reader.name ();
+
+		if(name == "vertices" || name == "constrained_vertices")
+		{
+			int numSrcCoords = -1;
+			if (const char* attrib = reader.attribute ("coords"))
+				numSrcCoords = atoi (attrib);
+
+			if (numSrcCoords < 1)
+				throw FileParseError (string ("Not enough coordinates provided in ") + filename);
+
+			if (lastNumSrcCoords >= 0 && lastNumSrcCoords != numSrcCoords)
+				throw FileParseError (string ("Can't read vertices with differing numbers "
+			            "of coordinates from ") + filename);
+
+			lastNumSrcCoords = numSrcCoords;
+			coords.set_tuple_size (numSrcCoords);
+
+			StreamNumbersToArrayAnnex (coords, reader, ParseRealToken);
+			reader.skip_element ();
+		}
+
+		else if(name == "edges"
+		        || name == "constraining_edges"
+		        || name == "constrained_edges")
+		{
+			StreamNumbersToArrayAnnex (mesh->grobs (EDGE).underlying_array (), reader, ParseIndexToken);
+			reader.skip_element ();
+		}
+
+		else if(name == "triangles"
+		        || name == "constraining_triangles"
+		        || name == "constrained_triangles")
+		{
+			StreamNumbersToArrayAnnex (mesh->grobs (TRI).underlying_array (), reader, ParseIndexToken);
+			reader.skip_element ();
+		}
+
+		else if(name == "quadrilaterals"
+		        || name == "constraining_quadrilaterals"
+		        || name == "constrained_quadrilaterals")
+		{
+			StreamNumbersToArrayAnnex (mesh->grobs (QUAD).underlying_array (), reader, ParseIndexToken);
+			reader.skip_element ();
+		}
+
+		else if(name == "tetrahedrons") {
+			StreamNumbersToArrayAnnex (mesh->grobs (TET).underlying_array (), reader, ParseIndexToken);
+			reader.skip_element ();
+		}
+
+		else if(name == "hexahedrons") {
+			StreamNumbersToArrayAnnex (mesh->grobs (HEX).underlying_array (), reader, ParseIndexToken);
+			reader.skip_element ();
+		}
+
+		else if(name == "pyramids") {
+			StreamNumbersToArrayAnnex (mesh->grobs (PYRA).underlying_array (), reader, ParseIndexToken);
+			reader.skip_element ();
+		}
+
+		else if(name == "prisms") {
+			StreamNumbersToArrayAnnex (mesh->grobs (PRISM).underlying_array (), reader, ParseIndexToken);
+			reader.skip_element ();
+		}
+
+		else if(name == "subset_handler") {
+		//	make sure that vertex indices are present
+			impl::GenerateVertexIndicesFromCoords (*mesh);
+
+			string siName = "subsetHandler";
+			if (const char* attrib = reader.attribute ("name"))
+				siName = attrib;
+
+			const auto indMaps = CreateUGXIndexMaps (*mesh);
+
+			SPSubsetInfoAnnex subsetInfo = make_shared <SubsetInfoAnnex> (siName);
+			subsetInfo->add_subset (SubsetInfoAnnex::SubsetProperties ());
+
+			index_t subsetIndex = 1;
+			while (reader.next () == XMLStreamReader::START_TAG) {
+				SubsetInfoAnnex::SubsetProperties props;
+				if (const char* attrib = reader.attribute ("name"))
+					props.name = attrib;
+				if (const char* attrib = reader.attribute ("color"))
+					props.color = ParseColor (attrib);
+
+			//	indices in the child nodes are referring to all elements of one
+			//	dimension. They are mapped to indices of individual grob types.
+				while (reader.next () == XMLStreamReader::START_TAG) {
+					const string& elemName = reader.name ();
+					index_t dim = 0;
+					if (elemName == "vertices")		dim = 0;
+					else if (elemName == "edges")	dim = 1;
+					else if (elemName == "faces")	dim = 2;
+					else if (elemName == "volumes")	dim = 3;
+					else {
+						reader.skip_element ();
+						continue;
+					}
+
+					const GrobSet gs = GrobSet (GrobSetTypeByDim (dim));
+					ArrayAnnexTable <IndexArrayAnnex> annexTable (mesh, siName, gs, true);
+					annexTable.resize_annexes_to_match_grobs (1);
+
+					const TotalToGrobIndexMap& indMap = indMaps [dim];
+					reader.for_each_token ([&] (const char* token) {
+						index_t totalInd;
+						if (!ParseIndexToken (totalInd, token))
+							throw reader.error (string ("Invalid number '").append (token).
+							                    append ("' in element '").append (elemName).append ("'"));
+						annexTable [indMap (totalInd)] = subsetIndex;
+					});
+					reader.skip_element ();
+				}
+
+				subsetInfo->add_subset (std::move (props));
+				++subsetIndex;
+			}
+
+			mesh->set_annex (siName, NO_GROB, subsetInfo);
+		}
+
+		else
+			reader.skip_element ();
+	}
+
+	if (event == XMLStreamReader::END_OF_FILE)
+		throw reader.error ("Unexpected end of file");
+
+	return mesh;
+}
+
+
+/// size of the window through which `CreateMeshFromUGXStream` reads files
+static const size_t UGX_STREAM_WINDOW_SIZE = size_t (1) << 20;
+
+std::shared_ptr <Mesh> CreateMeshFromUGXStream (std::string filename)
+{
+	auto mesh = CreateMeshFromUGXStream (filename, UGX_STREAM_WINDOW_SIZE, LoadProgressCallback ());
+	impl::GenerateVertexIndicesFromCoords (*mesh);
+	return mesh;
+}
+
+/// returns the size of the given file in bytes or 0 if it can't be opened
+static size_t FileSize (const std::string& filename)
+{
+	ifstream in (filename, ios::binary | ios::ate);
+	if (!in)
+		return 0;
+	return size_t (in.tellg ());
+}
+
+/// stamp of all files from which a mesh is created. `.ele` meshes also read the corresponding `.node` file.
+static FileStamp CreateSourceStamp (const string& filename, const string& suffix, const bool hashContents)
+{
+	FileStamp stamp = CreateFileStamp (filename, hashContents);
+	if (suffix == ".ele") {
+		const FileStamp nodeStamp = CreateFileStamp (filename.substr (0, filename.size() - 4) + ".node",
+		                                             hashContents);
+		stamp.size += nodeStamp.size;
+		stamp.modificationTime = max (stamp.modificationTime, nodeStamp.modificationTime);
+		stamp.contentHash ^= nodeStamp.contentHash * 0x9e3779b97f4a7c15ULL;
+	}
+	return stamp;
+}
+
+/// Loads the binary cache of a mesh if it is up to date. Returns an empty pointer otherwise.
+/** Size and modification time of the source are compared first. If only the
+ * modification time differs, the hash of the source's contents decides. The
+ * stamp of the cache is updated in that case, if the cache is writable.*/
+static SPMesh LoadBinaryMeshCache (const string& filename, const string& suffix,
+                                   const string& cacheFilename,
+                                   const LoadProgressCallback& progress)
+{
+	try {
+		const FileStamp cacheStamp = ReadBinaryMeshFileStamp (cacheFilename);
+		const FileStamp sourceStamp = CreateSourceStamp (filename, suffix, false);
+		if (sourceStamp.size != cacheStamp.size)
+			return SPMesh ();
+
+		if (sourceStamp.modificationTime != cacheStamp.modificationTime) {
+			const FileStamp hashedStamp = CreateSourceStamp (filename, suffix, true);
+			if (hashedStamp.contentHash != cacheStamp.contentHash)
+				return SPMesh ();
+
+		//	the source was only touched. Refreshing the stamp of the cache avoids
+		//	hashing the source again during the next load.
+			try {
+				WriteBinaryMeshFileStamp (cacheFilename, hashedStamp);
+			}
+			catch (FileIOError&) {}
+		}
+
+		ReportProgress (progress, "reading cache", 0, FileSize (cacheFilename));
+		return CreateMeshFromBinaryFile (cacheFilename);
+	}
+	catch (FileIOError&) {
+		return SPMesh ();
+	}
+}
+
+std::shared_ptr <Mesh> CreateMeshFromFile (std::string filename,
+                                           const bool useBinaryCache,
+                                           const LoadProgressCallback& progress,
+                                           const bool streamUGX)
 {
 	string suffix = filename.substr(filename.size() - 4, 4);
 	transform(suffix.begin(), suffix.end(), suffix.begin(), ::tolower);
 
+	if (suffix != ".stl" && suffix != ".ele" && suffix != ".ugx")
+		throw FileSuffixError (filename);
+
+	const string cacheFilename = filename + BINARY_MESH_CACHE_SUFFIX;
+	if (useBinaryCache) {
+		if (SPMesh mesh = LoadBinaryMeshCache (filename, suffix, cacheFilename, progress))
+			return mesh;
+	}
+
+	const size_t fileSize = FileSize (filename);
+	ReportProgress (progress, "parsing", 0, fileSize);
+
 	SPMesh mesh;
 	if (suffix == ".stl")
 		mesh = CreateMeshFromSTL (filename);
@@ -432,14 +1199,25 @@ std::shared_ptr <Mesh> CreateMeshFromFile (std::string filename)
 	else if (suffix == ".ele" )
 		mesh = CreateMeshFromELE (filename);
 
-	else if (suffix == ".ugx" )
-		mesh = CreateMeshFromUGX (filename);
-
 	else {
-		throw FileSuffixError (filename);
+		if (streamUGX)
+			mesh = CreateMeshFromUGXStream (filename, UGX_STREAM_WINDOW_SIZE, progress);
+		else
+			mesh = CreateMeshFromUGX (filename, progress);
 	}
 
 	impl::GenerateVertexIndicesFromCoords (*mesh);
+	ReportProgress (progress, "parsing", fileSize, fileSize);
+
+	if (useBinaryCache) {
+	//	the cache is optional. Loading succeeds e.g. in read-only directories, too.
+		ReportProgress (progress, "writing cache", 0, 0);
+		try {
+			WriteBinaryMeshFile (*mesh, cacheFilename, CreateSourceStamp (filename, suffix, true));
+		}
+		catch (FileIOError&) {}
+	}
+
 	return mesh;
 }
 
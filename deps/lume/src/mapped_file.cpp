@@ -0,0 +1,123 @@
+// This file is part of lume, a C++ library for lightweight unstructured meshes
+//
+// Copyright (C) 2018 Sebastian Reiter
+// Copyright (C) 2018 G-CSC, Goethe University Frankfurt
+// Author: Sebastian Reiter <s.b.reiter@gmail.com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <fstream>
+#include "lume/file_io.h"
+#include "lume/mapped_file.h"
+
+#if defined (__unix__) || defined (__APPLE__)
+	#define LUME_USE_MMAP
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace lume {
+
+#ifdef LUME_USE_MMAP
+
+MappedFile::MappedFile (const std::string& filename) :
+	m_data (nullptr),
+	m_size (0),
+	m_mapSize (0)
+{
+	const int fd = open (filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw FileNotFoundError (filename);
+
+	struct stat st;
+	if (fstat (fd, &st) != 0) {
+		close (fd);
+		throw FileIOError (string ("Couldn't determine the size of ").append (filename));
+	}
+
+	m_size = size_t (st.st_size);
+
+//	Reserve zero filled anonymous memory for the file and at least one additional
+//	byte, then map the file over its beginning. The byte behind the file is
+//	thus always zero, even if the file size is a multiple of the page size.
+	const size_t pageSize = size_t (sysconf (_SC_PAGESIZE));
+	m_mapSize = ((m_size + 1 + pageSize - 1) / pageSize) * pageSize;
+
+	void* base = mmap (nullptr, m_mapSize, PROT_READ | PROT_WRITE,
+	                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED) {
+		close (fd);
+		throw FileIOError (string ("Couldn't map ").append (filename));
+	}
+
+	if (m_size > 0) {
+		void* fileBase = mmap (base, m_size, PROT_READ | PROT_WRITE,
+		                       MAP_PRIVATE | MAP_FIXED, fd, 0);
+		if (fileBase == MAP_FAILED) {
+			munmap (base, m_mapSize);
+			close (fd);
+			throw FileIOError (string ("Couldn't map ").append (filename));
+		}
+		madvise (fileBase, m_size, MADV_SEQUENTIAL);
+	}
+
+	close (fd);
+	m_data = static_cast <char*> (base);
+}
+
+MappedFile::~MappedFile ()
+{
+	if (m_data)
+		munmap (m_data, m_mapSize);
+}
+
+#else
+
+MappedFile::MappedFile (const std::string& filename) :
+	m_data (nullptr),
+	m_size (0),
+	m_mapSize (0)
+{
+	ifstream in (filename, ios::binary);
+	if (!in)
+		throw FileNotFoundError (filename);
+
+	in.seekg (0, ios_base::end);
+	m_size = size_t (in.tellg());
+	in.seekg (0, ios_base::beg);
+
+	m_buffer.resize (m_size + 1);
+	in.read (m_buffer.data(), m_size);
+	m_buffer [m_size] = 0;
+	m_data = m_buffer.data();
+}
+
+MappedFile::~MappedFile ()
+{
+}
+
+#endif
+
+}//	end of namespace lume
@@ -28,6 +28,7 @@
 #include "lume/neighborhoods.h"
 #include "lume/topology.h"
 #include "pettyprof/pettyprof.h"
+#include <algorithm>
 #include <limits>
 
 using namespace std;
@@ -35,10 +36,13 @@ using namespace std;
 namespace lume {
 
 Neighborhoods::
-Neighborhoods ()
+Neighborhoods () :
+	m_overlaySize (0)
 {
-	for(index_t i = 0; i < MAX_GROB_SET_SIZE; ++i)
-		m_grobBaseInds[i] = 0;
+	for(index_t i = 0; i < NUM_GROB_TYPES; ++i) {
+		m_grobBaseInds[i] = NO_INDEX;
+		m_numCenters[i] = 0;
+	}
 
 	m_centerGrobTypes = NO_GROB_SET;
 	m_neighborGrobTypes = NO_GROB_SET;
@@ -67,9 +71,11 @@ refresh (SPMesh mesh, GrobSet centerGrobTypes, GrobSet neighborGrobTypes)
 	m_centerGrobTypes = centerGrobTypes;
 	m_neighborGrobTypes = neighborGrobTypes;
 
-	m_nbrs.set_tuple_size (2);
-	impl::FillNeighborMap (m_nbrs, m_offsets, m_grobBaseInds, *m_mesh,
+	m_nbrPacking = impl::PackedGrobIndex (*m_mesh, m_neighborGrobTypes);
+	m_nbrs.set_tuple_size (1);
+	impl::FillNeighborMap (m_nbrs, m_offsets, m_nbrPacking, m_grobBaseInds, *m_mesh,
 	                       m_centerGrobTypes, m_neighborGrobTypes);
+	reset_overlay ();
 }
 
 
@@ -82,9 +88,157 @@ refresh (SPMesh mesh, GrobSet grobTypes, const Neighborhoods& grobConnections)
 	m_centerGrobTypes = grobTypes;
 	m_neighborGrobTypes = grobTypes;
 
-	m_nbrs.set_tuple_size (2);
-	impl::FillNeighborMap (m_nbrs, m_offsets, m_grobBaseInds, *m_mesh,
+	m_nbrPacking = impl::PackedGrobIndex (*m_mesh, grobTypes);
+	m_nbrs.set_tuple_size (1);
+	impl::FillNeighborMap (m_nbrs, m_offsets, m_nbrPacking, m_grobBaseInds, *m_mesh,
 	                       grobTypes, grobConnections);
+	reset_overlay ();
+}
+
+
+void Neighborhoods::
+create_sides_and_refresh (SPMesh mesh, GrobSet grobSet)
+{
+	PEPRO_BEGIN(Neighborhoods__create_sides_and_refresh);
+
+	if (grobSet.dim() == 0)
+		throw LumeError ("Neighborhoods::create_sides_and_refresh: grobSet has no sides");
+
+	m_mesh = mesh;
+	m_centerGrobTypes = grobSet.side_set();
+	m_neighborGrobTypes = grobSet;
+
+	IndexArrayAnnex sideInds;
+	CreateSideGrobs (*m_mesh, grobSet, grobSet.dim() - 1, &sideInds);
+
+	index_t numCenters = 0;
+	VecSet (m_grobBaseInds, NUM_GROB_TYPES, NO_INDEX);
+	for(auto gt : m_centerGrobTypes) {
+		m_grobBaseInds [gt] = numCenters;
+		numCenters += m_mesh->num (gt);
+	}
+
+	m_nbrPacking = impl::PackedGrobIndex (*m_mesh, grobSet);
+	m_nbrs.set_tuple_size (1);
+	impl::FillHigherDimNeighborMapFromIncidences (
+			m_nbrs, m_offsets, m_nbrPacking, numCenters, *m_mesh, grobSet.dim() - 1, grobSet,
+			[this, &sideInds] (const Grob&, const index_t slot, const index_t)
+			{
+				return m_grobBaseInds [sideInds [2 * slot]] + sideInds [2 * slot + 1];
+			});
+	reset_overlay ();
+}
+
+
+void Neighborhoods::
+insert (const std::vector <std::pair <GrobIndex, GrobIndex>>& links)
+{
+	for(const auto& link : links)
+		check_link (link);
+
+//	neighbors of new types or with large indices may require a different packing
+	for(const auto& link : links) {
+		if (!m_nbrPacking.can_pack (link.second.grobType, link.second.index)) {
+			compact ();
+			break;
+		}
+	}
+
+	for(const auto& link : links) {
+		vector <index_t>& nbrs = overlay_neighbors (link.first);
+		const index_t packed = m_nbrPacking.pack (link.second.grobType, link.second.index);
+		if (find (nbrs.begin(), nbrs.end(), packed) == nbrs.end()) {
+			nbrs.push_back (packed);
+			++m_overlaySize;
+		}
+	}
+
+	if (m_overlaySize > max (index_t (4096), m_nbrs.size() / 8))
+		compact ();
+}
+
+
+void Neighborhoods::
+erase (const std::vector <std::pair <GrobIndex, GrobIndex>>& links)
+{
+	for(const auto& link : links)
+		check_link (link);
+
+	for(const auto& link : links) {
+		if (!m_nbrPacking.can_pack (link.second.grobType, link.second.index))
+			continue;
+
+		vector <index_t>& nbrs = overlay_neighbors (link.first);
+		const index_t packed = m_nbrPacking.pack (link.second.grobType, link.second.index);
+		const auto iter = find (nbrs.begin(), nbrs.end(), packed);
+		if (iter != nbrs.end()) {
+			nbrs.erase (iter);
+			--m_overlaySize;
+		}
+	}
+
+	if (m_overlaySize > max (index_t (4096), m_nbrs.size() / 8))
+		compact ();
+}
+
+
+void Neighborhoods::
+compact ()
+{
+	PEPRO_BEGIN(Neighborhoods__compact);
+
+	if (!m_mesh)
+		return;
+
+//	center grobs which were appended to the mesh are included
+	index_t baseInds [NUM_GROB_TYPES];
+	index_t numCenters [NUM_GROB_TYPES];
+	VecSet (baseInds, NUM_GROB_TYPES, NO_INDEX);
+	VecSet (numCenters, NUM_GROB_TYPES, 0);
+	index_t totalNumCenters = 0;
+	for(auto gt : m_centerGrobTypes) {
+		baseInds [gt] = totalNumCenters;
+		numCenters [gt] = max (m_numCenters [gt], m_mesh->num (gt));
+		totalNumCenters += numCenters [gt];
+	}
+
+	const impl::PackedGrobIndex nbrPacking (*m_mesh, m_neighborGrobTypes);
+
+	IndexArrayAnnex offsets;
+	offsets.resize (totalNumCenters + 1, 0);
+	for(auto gt : m_centerGrobTypes) {
+		parallel_for (index_t (0), numCenters [gt], [&] (const index_t i) {
+			const index_t* first;
+			index_t num;
+			neighbor_range (GrobIndex (gt, i), first, num);
+			offsets [baseInds [gt] + i] = num;
+		});
+	}
+
+	parallel_exclusive_scan (offsets.begin(), offsets.end(), offsets.begin(), index_t (0));
+
+	IndexArrayAnnex nbrs;
+	nbrs.resize (offsets.back());
+	for(auto gt : m_centerGrobTypes) {
+		parallel_for (index_t (0), numCenters [gt], [&] (const index_t i) {
+			const index_t* first;
+			index_t num;
+			neighbor_range (GrobIndex (gt, i), first, num);
+			index_t* dest = nbrs.raw_ptr() + offsets [baseInds [gt] + i];
+			for(index_t j = 0; j < num; ++j) {
+				const GrobIndex nbr = m_nbrPacking.unpack (first [j]);
+				dest [j] = nbrPacking.pack (nbr.grobType, nbr.index);
+			}
+		});
+	}
+
+	m_offsets = std::move (offsets);
+	m_nbrs = std::move (nbrs);
+	m_nbrPacking = nbrPacking;
+	VecCopy (m_grobBaseInds, NUM_GROB_TYPES, baseInds);
+	VecCopy (m_numCenters, NUM_GROB_TYPES, numCenters);
+	m_overlay.clear ();
+	m_overlaySize = 0;
 }
 
 
@@ -100,7 +254,7 @@ neighbor_indices (const GrobIndex gi) const
 {
 	const index_t baseIndex = base_index (gi);
 
-	if (baseIndex >= m_offsets.size())
+	if (baseIndex == NO_INDEX || baseIndex >= m_offsets.size())
 		throw LumeError (std::string("This Neighborhoods instance doesn't provide "
 		                             "neighbors for grobs of type ")
 						.append (GrobName (gi.grobType)));
@@ -117,8 +271,10 @@ neighbor_grobs (const GrobIndex gi) const
 index_t Neighborhoods::
 num_neighbors (const GrobIndex gi) const
 {
-	const index_t oi = offset_index(gi);
-	return m_offsets [oi + 1] - m_offsets [oi];
+	const index_t* first;
+	index_t num;
+	neighbor_range (gi, first, num);
+	return num;
 }
 
 index_t Neighborhoods::
@@ -133,10 +289,94 @@ offset_index (const GrobIndex& gi) const
 	return base_index (gi) + gi.index;
 }
 
-const index_t* Neighborhoods::first_neighbor (const GrobIndex& gi) const
+void Neighborhoods::
+neighbor_range (const GrobIndex& gi, const index_t*& firstOut, index_t& numOut) const
+{
+	if (!m_overlay.empty ()) {
+		const auto iter = m_overlay.find (overlay_key (gi));
+		if (iter != m_overlay.end()) {
+			firstOut = iter->second.data();
+			numOut = static_cast <index_t> (iter->second.size());
+			return;
+		}
+	}
+
+//	center grobs which were appended to the mesh after the last compaction
+	if (gi.index >= m_numCenters [gi.grobType]) {
+		firstOut = nullptr;
+		numOut = 0;
+		return;
+	}
+
+	const index_t oi = offset_index (gi);
+	firstOut = m_nbrs.raw_ptr() + m_offsets [oi];
+	numOut = m_offsets [oi + 1] - m_offsets [oi];
+}
+
+
+void Neighborhoods::
+reset_overlay ()
+{
+	VecSet (m_numCenters, NUM_GROB_TYPES, 0);
+	for(auto gt : m_centerGrobTypes)
+		m_numCenters [gt] = m_mesh->num (gt);
+
+	m_overlay.clear ();
+	m_overlaySize = 0;
+}
+
+
+void Neighborhoods::
+check_link (const std::pair <GrobIndex, GrobIndex>& link) const
+{
+	const GrobIndex& center = link.first;
+	const GrobIndex& nbr = link.second;
+
+	bool centerOk = false;
+	for(auto gt : m_centerGrobTypes)
+		centerOk |= (gt == center.grobType);
+
+	bool nbrOk = false;
+	for(auto gt : m_neighborGrobTypes)
+		nbrOk |= (gt == nbr.grobType);
+
+	if (!centerOk || !nbrOk) {
+		throw LumeError (string ("Neighborhoods: Invalid link between grobs of type ").
+		                 append (GrobName (center.grobType)).append (" and ").
+		                 append (GrobName (nbr.grobType)));
+	}
+
+	if (center.index >= max (m_numCenters [center.grobType], m_mesh->num (center.grobType))
+	    || nbr.index >= m_mesh->num (nbr.grobType))
+	{
+		throw LumeError ("Neighborhoods: Link refers to a grob which doesn't exist in the mesh");
+	}
+}
+
+
+vector <index_t>& Neighborhoods::
+overlay_neighbors (const GrobIndex& gi)
+{
+	const std::uint64_t key = overlay_key (gi);
+	const auto iter = m_overlay.find (key);
+	if (iter != m_overlay.end())
+		return iter->second;
+
+//	start with the current neighbors from the CSR arrays
+	const index_t* first;
+	index_t num;
+	neighbor_range (gi, first, num);
+	vector <index_t>& nbrs = m_overlay [key];
+	nbrs.assign (first, first + num);
+	m_overlaySize += num;
+	return nbrs;
+}
+
+
+std::uint64_t Neighborhoods::
+overlay_key (const GrobIndex& gi)
 {
-	const index_t o = m_offsets [offset_index (gi)] * 2;
-	return m_nbrs.raw_ptr() +  o;
+	return (std::uint64_t (gi.grobType) << 32) | gi.index;
 }
 
 
@@ -32,17 +32,19 @@ namespace lume {
 
 ////////////////////////////////////////////////////////////////////////////////
 // NeighborIndices implementation
-index_t NeighborIndices::
-size () const
+NeighborIndices::
+NeighborIndices (const GrobIndex& grobIndex,
+                 const Neighborhoods* neighborhoods) :
+	m_grobIndex (grobIndex),
+	m_neighborhoods (neighborhoods)
 {
-	return m_neighborhoods->num_neighbors (m_grobIndex);
+	m_neighborhoods->neighbor_range (m_grobIndex, m_first, m_size);
 }
 
 GrobIndex NeighborIndices::
 neighbor (const index_t i) const
 {
-	const index_t* p = m_neighborhoods->first_neighbor(m_grobIndex) + i * 2;
-	return GrobIndex (static_cast<grob_t>(p[0]), p[1]);
+	return m_neighborhoods->m_nbrPacking.unpack (m_first [i]);
 }
 
 
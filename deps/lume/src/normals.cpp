@@ -25,10 +25,18 @@
 // THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <vector>
 #include "lume/normals.h"
 #include "lume/mesh.h"
+#include "lume/parallel_algorithms.h"
 #include "lume/vec_math_raw.h"
 
+using namespace std;
+
 namespace lume {
 
 real_t* TriangleNormal3 (real_t* normalOut,
@@ -46,6 +54,88 @@ real_t* TriangleNormal3 (real_t* normalOut,
 }
 
 
+real_t* FaceNormal3 (real_t* normalOut,
+                     const real_t* coords,
+                     const index_t* corners,
+                     const index_t numCorners)
+{
+	const index_t offset = numCorners / 2;
+
+	real_t d0[3];
+	real_t d1[3];
+
+	VecSub (d0, 3, coords + corners[offset] * 3, coords + corners[0] * 3);
+	VecSub (d1, 3, coords + corners[1 + offset] * 3, coords + corners[1] * 3);
+
+	VecNormalize (VecCross3 (normalOut, d0, d1), 3);
+	return normalOut;
+}
+
+
+///	Computes the normals of faces `[first, first + num)` like `FaceNormal3`
+/** The normals are written in structure-of-arrays layout to `nx, ny, nz`.
+ * Corner coordinates are first gathered into small local blocks, so that the
+ * cross products and normalizations run in branch free loops over contiguous
+ * arrays, which the compiler turns into SIMD code.*/
+static void FaceNormalsSoA3 (real_t* nx,
+                             real_t* ny,
+                             real_t* nz,
+                             const real_t* coords,
+                             const index_t* inds,
+                             const index_t numCorners,
+                             const index_t first,
+                             const index_t num)
+{
+	const index_t BLOCK_SIZE = 64;
+	const index_t offset = numCorners / 2;
+
+	real_t d0x [BLOCK_SIZE], d0y [BLOCK_SIZE], d0z [BLOCK_SIZE];
+	real_t d1x [BLOCK_SIZE], d1y [BLOCK_SIZE], d1z [BLOCK_SIZE];
+	real_t l [BLOCK_SIZE];
+
+	for(index_t blockBegin = first; blockBegin < first + num; blockBegin += BLOCK_SIZE) {
+		const index_t blockSize = min (BLOCK_SIZE, first + num - blockBegin);
+
+		for(index_t i = 0; i < blockSize; ++i) {
+			const index_t* corners = inds + (blockBegin + i) * numCorners;
+			const real_t* a0 = coords + corners [0] * 3;
+			const real_t* b0 = coords + corners [offset] * 3;
+			const real_t* a1 = coords + corners [1] * 3;
+			const real_t* b1 = coords + corners [1 + offset] * 3;
+			d0x [i] = b0 [0] - a0 [0];
+			d0y [i] = b0 [1] - a0 [1];
+			d0z [i] = b0 [2] - a0 [2];
+			d1x [i] = b1 [0] - a1 [0];
+			d1y [i] = b1 [1] - a1 [1];
+			d1z [i] = b1 [2] - a1 [2];
+		}
+
+		real_t* ox = nx + blockBegin;
+		real_t* oy = ny + blockBegin;
+		real_t* oz = nz + blockBegin;
+		for(index_t i = 0; i < blockSize; ++i) {
+			ox [i] = d0y [i] * d1z [i] - d0z [i] * d1y [i];
+			oy [i] = d0z [i] * d1x [i] - d0x [i] * d1z [i];
+			oz [i] = d0x [i] * d1y [i] - d0y [i] * d1x [i];
+			l [i] = ox [i] * ox [i] + oy [i] * oy [i] + oz [i] * oz [i];
+		}
+
+	//	kept separate from the loop above, since sqrt may set errno and would
+	//	thus prevent vectorization of the whole loop
+		for(index_t i = 0; i < blockSize; ++i)
+			l [i] = sqrt (l [i]);
+
+	//	degenerated faces have a zero cross product and keep it as their normal
+		for(index_t i = 0; i < blockSize; ++i) {
+			const real_t s = l [i] != 0 ? l [i] : 1;
+			ox [i] /= s;
+			oy [i] /= s;
+			oz [i] /= s;
+		}
+	}
+}
+
+
 void
 ComputeFaceVertexNormals3 (Mesh& mesh,
 						  const std::string& normalId)
@@ -56,35 +146,96 @@ ComputeFaceVertexNormals3 (Mesh& mesh,
 	auto& normalArray = *mesh.annex<RealArrayAnnex> (normalId, VERTEX);
 	normalArray.set_tuple_size (3);
 	normalArray.resize (mesh.num_coords());
-	VecSet (UNPACK_DS(normalArray), 0);
 
 	const real_t*	coords		= mesh.coords()->raw_ptr();
 	real_t* 		normals		= normalArray.raw_ptr();
-	
-	for(auto gt : GrobSet (FACES)) {
-		const index_t*	inds		= mesh.grobs (gt).raw_ptr();
-		const index_t	numInds		= mesh.grobs (gt).num_indices();
-		const index_t	numCorners	= mesh.grobs (gt).grob_desc ().num_corners ();
-		const index_t	offset = numCorners / 2;
-
-		for (index_t i = 0; i < numInds; i += numCorners) {
-			const index_t* elem = inds + i;
-
-			real_t d0[3];
-			real_t d1[3];
-
-			VecSub (d0, 3, coords + elem[offset] * 3, coords + elem[0] * 3);
-			VecSub (d1, 3, coords + elem[1 + offset] * 3, coords + elem[1] * 3);
-
-			real_t n[3];
-			VecNormalize (VecCross3 (n, d0, d1), 3);
-
-			for(index_t j = 0; j < numCorners; ++j)
-				VecAppend (normals + elem [j] * 3, 3, n);
-		}
+	const index_t	numVrts		= normalArray.num_tuples();
+
+	const GrobSet faceTypes (FACES);
+	index_t faceBaseInds [MAX_GROB_SET_SIZE + 1] = {0};
+	for(index_t i = 0; i < faceTypes.size(); ++i)
+		faceBaseInds [i + 1] = faceBaseInds [i] + mesh.num (faceTypes.grob_type (i));
+
+//	compute the normals of all faces. Faces are indexed consecutively in the
+//	order of the types in FACES. The x, y and z components are stored in
+//	separate consecutive ranges of `faceNormals`.
+	const index_t numFaces = faceBaseInds [faceTypes.size()];
+	vector <real_t> faceNormals (numFaces * 3);
+	real_t* faceNormalsX = faceNormals.data();
+	real_t* faceNormalsY = faceNormalsX + numFaces;
+	real_t* faceNormalsZ = faceNormalsY + numFaces;
+
+	for(index_t i = 0; i < faceTypes.size(); ++i) {
+		const GrobArray& faces		= mesh.grobs (faceTypes.grob_type (i));
+		const index_t*	inds		= faces.raw_ptr();
+		const index_t	numCorners	= faces.grob_desc ().num_corners ();
+		const index_t	faceBase	= faceBaseInds [i];
+		const index_t	numBlocks	= (faces.size() + 1023) / 1024;
+
+		parallel_for (index_t (0), numBlocks, [&] (const index_t iblock) {
+			const index_t first = iblock * 1024;
+			FaceNormalsSoA3 (faceNormalsX + faceBase,
+			                 faceNormalsY + faceBase,
+			                 faceNormalsZ + faceBase,
+			                 coords, inds, numCorners,
+			                 first, min (index_t (1024), faces.size() - first));
+		});
 	}
 
-	VecTupNormalize (UNPACK_DST(normalArray));
+//	vertex to face incidences in CSR layout, created through a counting sort
+//	of the face corners. Faces are indexed consecutively as above.
+	unique_ptr <atomic <index_t> []> vrtFill (new atomic <index_t> [numVrts + 1]);
+	parallel_for (index_t (0), numVrts + 1, [&] (const index_t i) {vrtFill [i] = 0;});
+
+//	calls `func (vrt, faceIndex)` for each corner of each face
+	auto forEachCorner = [&] (const auto& func) {
+		for(index_t i = 0; i < faceTypes.size(); ++i) {
+			const GrobArray& faces		= mesh.grobs (faceTypes.grob_type (i));
+			const index_t*	inds		= faces.raw_ptr();
+			const index_t	numCorners	= faces.grob_desc ().num_corners ();
+			const index_t	faceBase	= faceBaseInds [i];
+
+			parallel_for (index_t (0), faces.size(), [&] (const index_t iface) {
+				const index_t* elem = inds + iface * numCorners;
+				for(index_t k = 0; k < numCorners; ++k)
+					func (elem [k], faceBase + iface);
+			});
+		}
+	};
+
+	forEachCorner ([&] (const index_t vrt, const index_t) {
+		vrtFill [vrt].fetch_add (1, memory_order_relaxed);
+	});
+
+	vector <index_t> vrtFaceOffsets (numVrts + 1);
+	parallel_exclusive_scan (vrtFill.get(), vrtFill.get() + numVrts + 1,
+	                         vrtFaceOffsets.begin(), index_t (0));
+	parallel_for (index_t (0), numVrts + 1, [&] (const index_t i) {
+		vrtFill [i] = vrtFaceOffsets [i];
+	});
+
+	vector <index_t> vrtFaces (vrtFaceOffsets [numVrts]);
+	forEachCorner ([&] (const index_t vrt, const index_t face) {
+		vrtFaces [vrtFill [vrt].fetch_add (1, memory_order_relaxed)] = face;
+	});
+	vrtFill.reset ();
+
+//	Each vertex gathers the normals of its faces. Sorting the faces of each
+//	vertex first sums each normal in the same order as a sequential scatter
+//	would, so that results don't depend on the number of threads.
+	parallel_for (index_t (0), numVrts, [&] (const index_t vrt) {
+		index_t* first = vrtFaces.data() + vrtFaceOffsets [vrt];
+		index_t* last = vrtFaces.data() + vrtFaceOffsets [vrt + 1];
+		sort (first, last);
+
+		real_t n[3] = {0, 0, 0};
+		for(index_t* f = first; f != last; ++f) {
+			n [0] += faceNormalsX [*f];
+			n [1] += faceNormalsY [*f];
+			n [2] += faceNormalsZ [*f];
+		}
+		VecNormalize (normals + vrt * 3, 3, n);
+	});
 }
 
 }// end of namespace lume
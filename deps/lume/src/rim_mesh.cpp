@@ -36,8 +36,6 @@ void CreateRimMesh (SPMesh rimMeshOut,
                       const std::function <void (const GrobIndex& rimGrob, const GrobIndex& srcGrob)>& gotRimGrobFunc,
                       const Neighborhoods* nbrhds)
 {
-	rimMeshOut->set_coords (mesh->coords());
-
 	GrobSet rimGrobSet = grobSet.side_set ();
 
 	Neighborhoods localNbrhds;
@@ -48,27 +46,17 @@ void CreateRimMesh (SPMesh rimMeshOut,
 	else if (nbrhds->center_grob_set() != rimGrobSet || nbrhds->neighbor_grob_set() != grobSet)
 		throw LumeError ("CreateRimMesh can't operate on provided neighborhoods instance. ");
 	
-	const Neighborhoods& neighborhoods = *nbrhds;
+	index_t firstRimGrobs [NUM_GROB_TYPES];
+	for(auto gt : rimGrobSet)
+		firstRimGrobs [gt] = rimMeshOut->num (gt);
+
+	IndexArrayAnnex srcGrobs;
+	CreateRimMesh (*rimMeshOut, *mesh, *nbrhds, visFunc, &srcGrobs);
 
-	for(auto rimGrobType : rimGrobSet) {
-		index_t counter = 0;
-		for(auto rimGrob : mesh->grobs (rimGrobType)) {
-			const GrobIndex rgi (rimGrobType, counter++);
-			NeighborIndices nbrs = neighborhoods.neighbor_indices (rgi);
-			index_t numVis = 0;
-			GrobIndex visNbrGrobIndex;
-			for(auto nbrGI : nbrs) {
-				if (visFunc (nbrGI)){
-					visNbrGrobIndex = nbrGI;
-					++numVis;
-				}
-			}
-			if (numVis == 1) {
-				rimMeshOut->insert (rimGrob);
-				gotRimGrobFunc (GrobIndex(rimGrobType, rimMeshOut->num (rimGrobType)),
-				                visNbrGrobIndex);
-			}
-		}
+	const index_t* src = srcGrobs.raw_ptr ();
+	for(auto gt : rimGrobSet) {
+		for(index_t i = firstRimGrobs [gt]; i < rimMeshOut->num (gt); ++i, src += 2)
+			gotRimGrobFunc (GrobIndex (gt, i), GrobIndex (static_cast <grob_t> (src [0]), src [1]));
 	}
 }
 
@@ -0,0 +1,275 @@
+// This file is part of lume, a C++ library for lightweight unstructured meshes
+//
+// Copyright (C) 2018 Sebastian Reiter
+// Copyright (C) 2018 G-CSC, Goethe University Frankfurt
+// Author: Sebastian Reiter <s.b.reiter@gmail.com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstdlib>
+#include "lume/thread_pool.h"
+
+using namespace std;
+
+namespace lume {
+
+namespace {
+	thread_local ThreadPool*	t_pool = nullptr;
+	thread_local int			t_queueIndex = -1;
+	thread_local ThreadPool*	t_scopePool = nullptr;
+
+	mutex						g_globalPoolMutex;
+	unique_ptr <ThreadPool>		g_globalPool;
+}
+
+
+ThreadPool::
+ThreadPool (const index_t numThreads) :
+	m_numPending (0),
+	m_stop (false)
+{
+	const index_t numWorkers = numThreads > 1 ? numThreads - 1 : 0;
+
+	for(index_t i = 0; i <= numWorkers; ++i)
+		m_queues.push_back (unique_ptr <Queue> (new Queue));
+
+	m_workers.reserve (numWorkers);
+	for(index_t i = 0; i < numWorkers; ++i)
+		m_workers.emplace_back (&ThreadPool::worker_main, this, static_cast <int> (i));
+}
+
+
+ThreadPool::
+~ThreadPool ()
+{
+	{
+		lock_guard <mutex> lock (m_sleepMutex);
+		m_stop = true;
+	}
+	m_wakeUp.notify_all ();
+
+	for(auto& w : m_workers)
+		w.join ();
+}
+
+
+ThreadPool& ThreadPool::
+global ()
+{
+	lock_guard <mutex> lock (g_globalPoolMutex);
+	if (!g_globalPool)
+		g_globalPool.reset (new ThreadPool (default_num_threads ()));
+	return *g_globalPool;
+}
+
+
+ThreadPool& ThreadPool::
+current ()
+{
+	if (t_scopePool)
+		return *t_scopePool;
+	if (t_pool)
+		return *t_pool;
+	return global ();
+}
+
+
+ThreadPool::CurrentScope::
+CurrentScope (ThreadPool& pool) :
+	m_previous (t_scopePool)
+{
+	t_scopePool = &pool;
+}
+
+
+ThreadPool::CurrentScope::
+~CurrentScope ()
+{
+	t_scopePool = m_previous;
+}
+
+
+void ThreadPool::
+set_num_threads (const index_t numThreads)
+{
+	lock_guard <mutex> lock (g_globalPoolMutex);
+	g_globalPool.reset ();
+	g_globalPool.reset (new ThreadPool (numThreads));
+}
+
+
+index_t ThreadPool::
+default_num_threads ()
+{
+	if (const char* env = getenv ("LUME_NUM_THREADS")) {
+		const int n = atoi (env);
+		if (n > 0)
+			return static_cast <index_t> (n);
+	}
+
+	return max <index_t> (1, thread::hardware_concurrency ());
+}
+
+
+void ThreadPool::
+submit (TaskGroup& group, Task task)
+{
+	++group.m_numOpen;
+
+	const int own = own_queue ();
+	Queue& q = *m_queues [own >= 0 ? own : m_queues.size() - 1];
+	{
+		lock_guard <mutex> lock (q.mutex);
+		q.entries.push_back (Entry {move (task), &group});
+	}
+
+	{
+	//	locking the mutex avoids a lost wake-up of a worker which is about to sleep
+		lock_guard <mutex> lock (m_sleepMutex);
+		++m_numPending;
+	}
+	m_wakeUp.notify_one ();
+//	waiting workers may steal the new task, too
+	m_taskDone.notify_all ();
+}
+
+
+void ThreadPool::
+wait (TaskGroup& group)
+{
+	const int own = own_queue ();
+	Entry entry;
+	while (!group.done ()) {
+		if (own >= 0 ? pop_task (entry, own) : pop_group_task (entry, group)) {
+			run (entry);
+			continue;
+		}
+
+	//	All remaining tasks of the group are being executed by other threads.
+	//	Workers additionally wake up to execute newly submitted tasks.
+		unique_lock <mutex> lock (m_sleepMutex);
+		m_taskDone.wait (lock, [this, &group, own] ()
+			{return group.done () || (own >= 0 && m_numPending > 0);});
+	}
+}
+
+
+void ThreadPool::
+run (Entry& entry)
+{
+	entry.task ();
+	entry.task = nullptr;
+
+	TaskGroup& group = *entry.group;
+	if (--group.m_numOpen == 0) {
+	//	locking the mutex avoids a lost wake-up of a thread which is about to wait
+		{lock_guard <mutex> lock (m_sleepMutex);}
+		m_taskDone.notify_all ();
+	}
+}
+
+
+int ThreadPool::
+own_queue () const
+{
+	return t_pool == this ? t_queueIndex : -1;
+}
+
+
+bool ThreadPool::
+pop_task (Entry& entryOut, const int ownQueue)
+{
+	if (m_numPending == 0)
+		return false;
+
+//	newest task from the own queue
+	if (ownQueue >= 0) {
+		Queue& q = *m_queues [ownQueue];
+		lock_guard <mutex> lock (q.mutex);
+		if (!q.entries.empty ()) {
+			entryOut = move (q.entries.back ());
+			q.entries.pop_back ();
+			--m_numPending;
+			return true;
+		}
+	}
+
+//	oldest task from any other queue
+	const int numQueues = static_cast <int> (m_queues.size());
+	const int first = ownQueue >= 0 ? ownQueue + 1 : 0;
+	for(int i = 0; i < numQueues; ++i) {
+		const int qi = (first + i) % numQueues;
+		if (qi == ownQueue)
+			continue;
+
+		Queue& q = *m_queues [qi];
+		lock_guard <mutex> lock (q.mutex);
+		if (!q.entries.empty ()) {
+			entryOut = move (q.entries.front ());
+			q.entries.pop_front ();
+			--m_numPending;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+bool ThreadPool::
+pop_group_task (Entry& entryOut, const TaskGroup& group)
+{
+//	tasks of threads which aren't workers of this pool are all submitted to the last queue
+	Queue& q = *m_queues.back ();
+	lock_guard <mutex> lock (q.mutex);
+	for(auto i = q.entries.begin(); i != q.entries.end(); ++i) {
+		if (i->group == &group) {
+			entryOut = move (*i);
+			q.entries.erase (i);
+			--m_numPending;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void ThreadPool::
+worker_main (const int queueIndex)
+{
+	t_pool = this;
+	t_queueIndex = queueIndex;
+
+	Entry entry;
+	while (true) {
+		if (pop_task (entry, queueIndex)) {
+			run (entry);
+			continue;
+		}
+
+		unique_lock <mutex> lock (m_sleepMutex);
+		m_wakeUp.wait (lock, [this] () {return m_stop || m_numPending > 0;});
+		if (m_stop)
+			return;
+	}
+}
+
+}//	end of namespace lume
@@ -25,7 +25,11 @@
 // THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include "lume/mesh.h"
+#include "lume/parallel_algorithms.h"
 #include "lume/topology.h"
 #include "lume/vec_math_raw.h"
 
@@ -53,56 +57,226 @@ namespace impl {
 }// end of namespace impl
 
 TotalToGrobIndexMap::
-TotalToGrobIndexMap (Mesh& mesh, const GrobSet& gs)
+TotalToGrobIndexMap (const Mesh& mesh, const GrobSet& gs)
 {
-	m_grobTypes.reserve (gs.size());
+	grob_t grobTypes [MAX_GROB_SET_SIZE];
+	index_t numGrobTypes = 0;
 	for(auto grobType : gs)
-		m_grobTypes.push_back (grobType);
-	
-	generate_base_inds (mesh);
+		grobTypes [numGrobTypes++] = grobType;
+
+	init (mesh, grobTypes, numGrobTypes);
 }
 
 
 TotalToGrobIndexMap::
-TotalToGrobIndexMap (Mesh& mesh, const std::vector <grob_t>& gs) :
-	m_grobTypes (gs)
+TotalToGrobIndexMap (const Mesh& mesh, const std::vector <grob_t>& gs)
 {
-	generate_base_inds (mesh);
-}
+	if (gs.size() > MAX_GROB_SET_SIZE) {
+		throw LumeError (string("TotalToGrobIndexMap: At most ").
+		                 append (to_string (MAX_GROB_SET_SIZE)).
+		                 append (" grob types are supported"));
+	}
 
-TotalToGrobIndexMap::
-TotalToGrobIndexMap (Mesh& mesh, std::vector <grob_t>&& gs) :
-	m_grobTypes (std::move (gs))
-{
-	generate_base_inds (mesh);
+	init (mesh, gs.data(), index_t (gs.size()));
 }
 
 
 void TotalToGrobIndexMap::
-generate_base_inds (Mesh& mesh)
+init (const Mesh& mesh, const grob_t* grobTypes, const index_t numGrobTypes)
 {
-	m_baseInds.resize(m_grobTypes.size() + 1);
-    m_baseInds[0] = 0;
-    const size_t numGrobTypes = m_grobTypes.size();
-    for(size_t i = 0; i < numGrobTypes; ++i)
-     	m_baseInds [i+1] = m_baseInds [i] + mesh.num (m_grobTypes [i]);
+//	unused slots are padded with empty ranges at the end, so that 'rank'
+//	never selects them for valid indices.
+	m_baseInds [0] = 0;
+	for(index_t i = 0; i < MAX_GROB_SET_SIZE; ++i) {
+		if (i < numGrobTypes) {
+			m_grobTypes [i] = grobTypes [i];
+			m_baseInds [i+1] = m_baseInds [i] + mesh.num (grobTypes [i]);
+		}
+		else {
+			m_grobTypes [i] = NO_GROB;
+			m_baseInds [i+1] = m_baseInds [i];
+		}
+	}
 }
 
+
 GrobIndex TotalToGrobIndexMap::
 operator () (const index_t ind) const
 {
-	const size_t numGrobTypes = m_grobTypes.size();
-    for(size_t i = 0; i < numGrobTypes; ++i) {
-      	if (ind >= m_baseInds [i] && ind < m_baseInds [i+1])
-        	return GrobIndex(m_grobTypes[i], ind - m_baseInds[i]);
-    }
+	if (ind >= size()) {
+	    throw LumeError (string("TotalToGrobIndexMap: Couldn't map index ").
+	    					append (to_string(ind)));
+	}
+
+	const index_t r = rank (ind);
+	return GrobIndex (m_grobTypes [r], ind - m_baseInds [r]);
+}
+
+
+void TotalToGrobIndexMap::
+map (std::vector <index_t>* grobIndsOut,
+     const index_t* totalInds,
+     const index_t numInds) const
+{
+	const index_t numTotal = size();
+	index_t counts [MAX_GROB_SET_SIZE] = {0};
+	for(index_t i = 0; i < numInds; ++i) {
+		const index_t ind = totalInds [i];
+		if (ind >= numTotal) {
+		    throw LumeError (string("TotalToGrobIndexMap: Couldn't map index ").
+		    					append (to_string(ind)));
+		}
+		++counts [rank (ind)];
+	}
+
+	std::vector <index_t>* outs [MAX_GROB_SET_SIZE] = {nullptr};
+	for(index_t r = 0; r < MAX_GROB_SET_SIZE; ++r) {
+		if (counts [r] > 0) {
+			outs [r] = &grobIndsOut [m_grobTypes [r]];
+			outs [r]->reserve (outs [r]->size() + counts [r]);
+		}
+	}
+
+	for(index_t i = 0; i < numInds; ++i) {
+		const index_t ind = totalInds [i];
+		const index_t r = rank (ind);
+		outs [r]->push_back (ind - m_baseInds [r]);
+	}
+}
+
+
+
+GrobIndexTable::
+GrobIndexTable (const Mesh& mesh, const GrobSet grobSet) :
+	m_mesh (&mesh),
+	m_grobSet (grobSet),
+	m_numGrobs (0)
+{
+	fill (m_baseInds, m_baseInds + NUM_GROB_TYPES, NO_INDEX);
+	for(auto gt : grobSet) {
+		m_baseInds [gt] = m_numGrobs;
+		m_numGrobs += mesh.num (gt);
+	}
+
+//	vertices are looked up directly by their corner index
+	const bool direct = (grobSet == VERTICES);
+
+	index_t numBuckets = 0;
+	for(auto gt : grobSet) {
+		if (!mesh.has (gt))
+			continue;
+		const GrobArray& grobs = mesh.grobs (gt);
+		numBuckets = parallel_reduce (
+				index_t (0), grobs.size(), numBuckets,
+				[&grobs, this] (const index_t m, const index_t i) {
+					return max (m, min_corner (grobs [i]) + 1);
+				},
+				[] (const index_t a, const index_t b) {return max (a, b);});
+	}
+
+	if (direct) {
+		m_entries.resize (numBuckets, NO_INDEX);
+		if (mesh.has (VERTEX)) {
+			const GrobArray& vrts = mesh.grobs (VERTEX);
+			const index_t base = m_baseInds [VERTEX];
+			parallel_for (index_t (0), vrts.size(), [&] (const index_t i) {
+				m_entries [vrts [i].corner (0)] = base + i;
+			});
+		}
+		return;
+	}
+
+//	counting sort of all grobs by their smallest corner
+	unique_ptr <atomic <index_t> []> bucketFill (new atomic <index_t> [numBuckets + 1]);
+	parallel_for (index_t (0), numBuckets + 1, [&] (const index_t i) {bucketFill [i] = 0;});
+	for(auto gt : grobSet) {
+		if (!mesh.has (gt))
+			continue;
+		const GrobArray& grobs = mesh.grobs (gt);
+		parallel_for (index_t (0), grobs.size(), [&] (const index_t i) {
+			bucketFill [min_corner (grobs [i])].fetch_add (1, memory_order_relaxed);
+		});
+	}
+
+	m_bucketOffsets.resize (numBuckets + 1);
+	parallel_exclusive_scan (bucketFill.get(), bucketFill.get() + numBuckets + 1,
+	                         m_bucketOffsets.begin(), index_t (0));
+	parallel_for (index_t (0), numBuckets + 1, [&] (const index_t i) {
+		bucketFill [i] = m_bucketOffsets [i];
+	});
+
+	m_entries.resize (m_numGrobs);
+	for(auto gt : grobSet) {
+		if (!mesh.has (gt))
+			continue;
+		const GrobArray& grobs = mesh.grobs (gt);
+		const index_t base = m_baseInds [gt];
+		parallel_for (index_t (0), grobs.size(), [&] (const index_t i) {
+			const index_t c = min_corner (grobs [i]);
+			m_entries [bucketFill [c].fetch_add (1, memory_order_relaxed)] = base + i;
+		});
+	}
+}
+
+
+index_t GrobIndexTable::
+find (const Grob& grob) const
+{
+	const index_t c = min_corner (grob);
+
+	if (m_bucketOffsets.empty()) {
+		if (c >= m_entries.size() || grob.grob_type() != VERTEX)
+			return NO_INDEX;
+		return m_entries [c];
+	}
+
+	if (c + 1 >= m_bucketOffsets.size())
+		return NO_INDEX;
+
+	const index_t end = m_bucketOffsets [c + 1];
+	for(index_t i = m_bucketOffsets [c]; i < end; ++i) {
+		const index_t ind = m_entries [i];
+		if (m_mesh->grob (to_grob_index (ind)) == grob)
+			return ind;
+	}
+	return NO_INDEX;
+}
+
+
+GrobIndex GrobIndexTable::
+grob_index (const Grob& grob) const
+{
+	const index_t ind = find (grob);
+	if (ind == NO_INDEX) {
+		throw LumeError (string ("GrobIndexTable: Couldn't find grob of type ").
+		                 append (grob.desc().name()));
+	}
+	return to_grob_index (ind);
+}
+
 
-    throw LumeError (string("TotalToGrobIndexMap: Couldn't map index ").
-    					append (to_string(ind)));
-    return GrobIndex (NO_GROB, 0);
+GrobIndex GrobIndexTable::
+to_grob_index (const index_t ind) const
+{
+	grob_t grobType = NO_GROB;
+	for(auto gt : m_grobSet) {
+		if (ind >= m_baseInds [gt])
+			grobType = gt;
+	}
+	return GrobIndex (grobType, ind - m_baseInds [grobType]);
 }
 
 
+index_t GrobIndexTable::
+min_corner (const Grob& grob) const
+{
+	const index_t numCorners = grob.num_corners ();
+	index_t c = grob.corner (0);
+	for(index_t i = 1; i < numCorners; ++i)
+		c = min (c, grob.corner (i));
+	return c;
+}
+
 
 void FillGrobToIndexMap (GrobHashMap <index_t>& indexMapInOut,
                        index_t* grobBaseIndsOut,
@@ -207,18 +381,272 @@ index_t FindUniqueSides (GrobHash& sideHashInOut,
 }
 
 
-void CreateSideGrobs (Mesh& mesh, const index_t sideDim)
+namespace {
+
+///	Canonical key of a side together with the global index of the emitting side slot
+/** `key[0]` holds the side type, followed by the ascendingly sorted corners
+ * of the side. Unused corner entries are set to `NO_INDEX`.*/
+template <index_t N>
+struct SideRecord {
+	index_t key [N + 1];
+	index_t src;
+};
+
+template <index_t N>
+bool SameSide (const SideRecord <N>& a, const SideRecord <N>& b)
 {
-	const std::vector<grob_t> grobs = mesh.grob_types();
+	for(index_t i = 0; i <= N; ++i) {
+		if (a.key [i] != b.key [i])
+			return false;
+	}
+	return true;
+}
 
-	GrobHash hash;
-	for(auto gt : grobs) {
-		if(GrobDesc(gt).dim() > sideDim)
-			FindUniqueSides (hash, mesh, gt, sideDim);
+template <index_t N>
+index_t CreateSideGrobsImpl (Mesh& mesh,
+                             const vector <grob_t>& srcTypes,
+                             const index_t sideDim,
+                             IndexArrayAnnex* sideIndsOut)
+{
+//	each side of each source grob occupies one slot. Slots are numbered
+//	consecutively, starting with the sides of the first grob of srcTypes[0].
+	const size_t numSrcTypes = srcTypes.size();
+	vector <index_t> slotBase (numSrcTypes + 1, 0);
+	for(size_t i = 0; i < numSrcTypes; ++i) {
+		slotBase [i + 1] = slotBase [i] + mesh.num (srcTypes [i])
+		                   * GrobDesc (srcTypes [i]).num_sides (sideDim);
 	}
-	
+	const index_t numSlots = slotBase.back();
+
+//	emit the canonical keys of all sides
+	vector <SideRecord <N>> records (numSlots);
+	for(size_t itype = 0; itype < numSrcTypes; ++itype) {
+		const GrobDesc desc (srcTypes [itype]);
+		const index_t numCorners = desc.num_corners ();
+		const index_t numSides = desc.num_sides (sideDim);
+		const index_t* corners = mesh.grobs (srcTypes [itype]).raw_ptr ();
+		const index_t base = slotBase [itype];
+
+		parallel_for (index_t (0), mesh.num (srcTypes [itype]), [&] (const index_t igrob) {
+			const index_t* grobCorners = corners + igrob * numCorners;
+			for(index_t iside = 0; iside < numSides; ++iside) {
+				const index_t slot = base + igrob * numSides + iside;
+				SideRecord <N>& rec = records [slot];
+				const index_t* locCorners = desc.local_side_corners (sideDim, iside);
+				const grob_t sideType = desc.side_type (sideDim, iside);
+				const index_t numSideCorners = GrobDesc (sideType).num_corners ();
+
+				rec.key [0] = sideType;
+				index_t* c = rec.key + 1;
+				for(index_t i = 0; i < numSideCorners; ++i)
+					c [i] = grobCorners [locCorners [i]];
+				for(index_t i = numSideCorners; i < N; ++i)
+					c [i] = NO_INDEX;
+				sort (c, c + numSideCorners);
+				rec.src = slot;
+			}
+		});
+	}
+
+//	Sort the records by a counting sort on the bucket key (side type, smallest
+//	corner), which is a single digit radix sort with one digit per vertex. Each
+//	bucket only holds a few records, which are then sorted individually.
+	index_t sideTypeRank [NUM_GROB_TYPES];
+	fill (sideTypeRank, sideTypeRank + NUM_GROB_TYPES, NO_INDEX);
+	for(auto gt : srcTypes) {
+		const GrobDesc desc (gt);
+		for(index_t iside = 0; iside < desc.num_sides (sideDim); ++iside)
+			sideTypeRank [desc.side_type (sideDim, iside)] = 0;
+	}
+
+	index_t numSideTypes = 0;
+	for(index_t gt = 0; gt < NUM_GROB_TYPES; ++gt) {
+		if (sideTypeRank [gt] != NO_INDEX)
+			sideTypeRank [gt] = numSideTypes++;
+	}
+
+	const index_t numVrts = parallel_reduce (
+			records.begin(), records.end(), index_t (0),
+			[] (const index_t m, const SideRecord <N>& r) {return max (m, r.key [1] + 1);},
+			[] (const index_t a, const index_t b) {return max (a, b);});
+
+	const index_t numBuckets = numSideTypes * numVrts;
+	auto bucket = [&sideTypeRank, numVrts] (const SideRecord <N>& r) {
+		return sideTypeRank [r.key [0]] * numVrts + r.key [1];
+	};
+
+	unique_ptr <atomic <index_t> []> bucketFill (new atomic <index_t> [numBuckets]);
+	parallel_for (index_t (0), numBuckets, [&] (const index_t i) {bucketFill [i] = 0;});
+	parallel_for (index_t (0), numSlots, [&] (const index_t i) {
+		bucketFill [bucket (records [i])].fetch_add (1, memory_order_relaxed);
+	});
+
+	vector <index_t> bucketBegin (numBuckets + 1);
+	bucketBegin [numBuckets] = parallel_exclusive_scan (bucketFill.get(),
+	                                                    bucketFill.get() + numBuckets,
+	                                                    bucketBegin.begin(),
+	                                                    index_t (0));
+	parallel_for (index_t (0), numBuckets, [&] (const index_t i) {
+		bucketFill [i] = bucketBegin [i];
+	});
+
+	vector <SideRecord <N>> sorted (numSlots);
+	parallel_for (index_t (0), numSlots, [&] (const index_t i) {
+		sorted [bucketFill [bucket (records [i])].fetch_add (1, memory_order_relaxed)] = records [i];
+	});
+	vector <SideRecord <N>> ().swap (records);
+
+//	sorting by `src` as the last criterion places the first occurrence of
+//	each side at the head of its run.
+	parallel_for (index_t (0), numBuckets, [&] (const index_t ibucket) {
+		sort (sorted.begin() + bucketBegin [ibucket],
+		      sorted.begin() + bucketBegin [ibucket + 1],
+		      [] (const SideRecord <N>& a, const SideRecord <N>& b) {
+		      	for(index_t i = 1; i <= N; ++i) {
+		      		if (a.key [i] != b.key [i])
+		      			return a.key [i] < b.key [i];
+		      	}
+		      	return a.src < b.src;
+		      });
+	});
+
+//	mark the first record of each run of identical sides and enumerate those
+	vector <index_t> uniqueInds (numSlots);
+	parallel_for (index_t (0), numSlots, [&] (const index_t i) {
+		uniqueInds [i] = (i == 0 || !SameSide (sorted [i - 1], sorted [i])) ? 1 : 0;
+	});
+
+	const index_t numUnique = parallel_exclusive_scan (uniqueInds.begin(),
+	                                                   uniqueInds.end(),
+	                                                   uniqueInds.begin(),
+	                                                   index_t (0));
+
+//	records are grouped by side type. Find the first unique index of each type.
+//	Absent types share the base of the next present type.
+	index_t typeBase [NUM_GROB_TYPES + 1];
+	typeBase [NUM_GROB_TYPES] = numUnique;
+	for(index_t gt = NUM_GROB_TYPES; gt > 0; --gt) {
+		const index_t rank = sideTypeRank [gt - 1];
+		const index_t first = (rank == NO_INDEX) ? numSlots : bucketBegin [rank * numVrts];
+		typeBase [gt - 1] = (first < numSlots) ? uniqueInds [first] : typeBase [gt];
+	}
+
 	mesh.clear (GrobSetTypeByDim (sideDim));
-	mesh.insert (hash.begin(), hash.end());
+	index_t* sideCorners [NUM_GROB_TYPES];
+	for(index_t gt = 0; gt < NUM_GROB_TYPES; ++gt) {
+		const index_t num = typeBase [gt + 1] - typeBase [gt];
+		sideCorners [gt] = nullptr;
+		if (num > 0) {
+			GrobArray& sides = mesh.grobs (static_cast <grob_t> (gt));
+			sides.resize (num);
+			sideCorners [gt] = sides.raw_ptr ();
+		}
+	}
+
+	if (sideIndsOut) {
+		sideIndsOut->set_tuple_size (2);
+		sideIndsOut->resize (numSlots * 2);
+	}
+
+//	write unique sides in the orientation of their first occurrence
+	parallel_for (index_t (0), numSlots, [&] (const index_t i) {
+		const SideRecord <N>& rec = sorted [i];
+		const grob_t sideType = static_cast <grob_t> (rec.key [0]);
+		const bool isHead = (i == 0 || !SameSide (sorted [i - 1], rec));
+		const index_t uniqueInd = isHead ? uniqueInds [i] : uniqueInds [i] - 1;
+		const index_t sideInd = uniqueInd - typeBase [sideType];
+
+		if (sideIndsOut) {
+			(*sideIndsOut) [rec.src * 2] = sideType;
+			(*sideIndsOut) [rec.src * 2 + 1] = sideInd;
+		}
+
+		if (!isHead)
+			return;
+
+		const size_t itype = static_cast <size_t> (
+				upper_bound (slotBase.begin(), slotBase.end(), rec.src) - slotBase.begin()) - 1;
+		const GrobDesc desc (srcTypes [itype]);
+		const index_t numSides = desc.num_sides (sideDim);
+		const index_t igrob = (rec.src - slotBase [itype]) / numSides;
+		const index_t iside = (rec.src - slotBase [itype]) % numSides;
+		const index_t* grobCorners = mesh.grobs (srcTypes [itype]).raw_ptr ()
+		                             + igrob * desc.num_corners ();
+		const index_t* locCorners = desc.local_side_corners (sideDim, iside);
+		const index_t numSideCorners = GrobDesc (sideType).num_corners ();
+		index_t* c = sideCorners [sideType] + sideInd * numSideCorners;
+		for(index_t j = 0; j < numSideCorners; ++j)
+			c [j] = grobCorners [locCorners [j]];
+	});
+
+	return numUnique;
+}
+
+index_t CreateSideGrobsOfTypes (Mesh& mesh,
+                               const vector <grob_t>& srcTypes,
+                               const index_t sideDim,
+                               IndexArrayAnnex* sideIndsOut)
+{
+	index_t maxSideCorners = 0;
+	for(auto gt : srcTypes) {
+		const GrobDesc desc (gt);
+		for(index_t iside = 0; iside < desc.num_sides (sideDim); ++iside) {
+			maxSideCorners = max (maxSideCorners,
+			                      desc.side_desc (sideDim, iside).num_corners ());
+		}
+	}
+
+	switch (maxSideCorners) {
+		case 0:
+			if (sideIndsOut) {
+				sideIndsOut->set_tuple_size (2);
+				sideIndsOut->clear ();
+			}
+			mesh.clear (GrobSetTypeByDim (sideDim));
+			return 0;
+		case 1: return CreateSideGrobsImpl <1> (mesh, srcTypes, sideDim, sideIndsOut);
+		case 2: return CreateSideGrobsImpl <2> (mesh, srcTypes, sideDim, sideIndsOut);
+		case 3: return CreateSideGrobsImpl <3> (mesh, srcTypes, sideDim, sideIndsOut);
+		case 4: return CreateSideGrobsImpl <4> (mesh, srcTypes, sideDim, sideIndsOut);
+		default:
+			throw LumeError (string ("CreateSideGrobs: Unsupported number of side corners: ").
+			                 append (to_string (maxSideCorners)));
+	}
+}
+
+}// end of unnamed namespace
+
+
+void CreateSideGrobs (Mesh& mesh, const index_t sideDim)
+{
+	vector <grob_t> srcTypes;
+	for(auto gt : mesh.grob_types()) {
+		if(GrobDesc(gt).dim() > sideDim)
+			srcTypes.push_back (gt);
+	}
+
+	CreateSideGrobsOfTypes (mesh, srcTypes, sideDim, nullptr);
+}
+
+
+index_t CreateSideGrobs (Mesh& mesh,
+                         const GrobSet grobSet,
+                         const index_t sideDim,
+                         IndexArrayAnnex* sideIndsOut)
+{
+	if (grobSet.dim() <= sideDim) {
+		throw LumeError (string ("CreateSideGrobs: sideDim (").
+		                 append (to_string (sideDim)).
+		                 append (") has to be lower than the dimension of the given grob set"));
+	}
+
+	vector <grob_t> srcTypes;
+	for(auto gt : grobSet) {
+		if (mesh.has (gt))
+			srcTypes.push_back (gt);
+	}
+
+	return CreateSideGrobsOfTypes (mesh, srcTypes, sideDim, sideIndsOut);
 }
 
 
@@ -0,0 +1,34 @@
+#version 330 core
+
+layout (lines) in;
+layout (line_strip, max_vertices = 2) out;
+
+uniform vec4 color = vec4 (1.f, 1.f, 1.f, 1.f);
+
+//	subset index of each edge and visibility of each subset
+uniform usamplerBuffer primitiveSubsets;
+uniform usamplerBuffer subsetVisibilities;
+
+in VS_OUT {
+    vec3 viewPos;
+    float lightIntensity;
+} vrts[];
+
+out float elemLightIntensity;
+flat out vec4 elemColor;
+
+void main ()
+{
+	int si = int (texelFetch (primitiveSubsets, gl_PrimitiveIDIn).r);
+	if (texelFetch (subsetVisibilities, si).r == 0u)
+		return;
+
+	for (int i = 0; i < 2; ++i) {
+		elemLightIntensity = 0.5f * (vrts[0].lightIntensity + vrts[1].lightIntensity);
+		elemColor = color;
+		gl_Position = gl_in[i].gl_Position; 
+	    EmitVertex();
+	}
+
+    EndPrimitive();
+}
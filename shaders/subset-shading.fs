@@ -0,0 +1,15 @@
+#version 330 core
+
+uniform float zfacNear = 1.f;
+uniform float zfacFar = 1.f;
+
+in float elemLightIntensity;
+flat in vec4 elemColor;
+
+out vec4 fragColor;
+
+void main ()
+{
+	fragColor = vec4 (elemLightIntensity * elemColor.rgb, elemColor.a);
+	gl_FragDepth = gl_FragCoord.z * (mix(zfacNear, zfacFar, gl_FragCoord.z));
+}
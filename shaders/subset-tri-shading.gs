@@ -0,0 +1,42 @@
+#version 330 core
+
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+uniform float ambient = 0.2;
+uniform int flatShading = 1;
+
+//	subset index of each triangle, color and visibility of each subset
+uniform usamplerBuffer primitiveSubsets;
+uniform samplerBuffer subsetColors;
+uniform usamplerBuffer subsetVisibilities;
+
+in VS_OUT {
+    vec3 viewPos;
+    float lightIntensity;
+} vrts[];
+
+out float elemLightIntensity;
+flat out vec4 elemColor;
+
+void main ()
+{
+	int si = int (texelFetch (primitiveSubsets, gl_PrimitiveIDIn).r);
+	if (texelFetch (subsetVisibilities, si).r == 0u)
+		return;
+
+	vec4 color = texelFetch (subsetColors, si);
+
+	vec3 v0 = (vrts[1].viewPos - vrts[0].viewPos).xyz;
+	vec3 v1 = (vrts[2].viewPos - vrts[0].viewPos).xyz;
+	float flatIntensity = ambient + (1.0f - ambient) * abs(normalize(cross (v0, v1)).z);
+
+	for (int i = 0; i < 3; ++i) {
+		elemLightIntensity = (flatShading != 0) ? flatIntensity : vrts[i].lightIntensity;
+		elemColor = color;
+		gl_Position = gl_in[i].gl_Position; 
+	    EmitVertex();
+	}
+
+    EndPrimitive();
+}
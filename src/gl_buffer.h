@@ -28,6 +28,7 @@
 #define __H__lumeview__gl_buffer
 
 #include <glad/glad.h>	// include before other OpenGL related includes
+#include <memory>
 #include "config.h"
 #include "lumeview_error.h"
 
@@ -62,6 +63,8 @@ public:
 
 	index_t size () const		{return m_size;}
 	index_t capacity () const	{return m_capacity;}
+	GLenum type () const		{return m_type;}
+	uint id () const			{return m_id;}
 
 	/// makes sure that a buffer of the specified size is allocated.
 	/** \note this also binds the buffer 
@@ -106,6 +109,47 @@ private:
 	GLenum	m_memHint;
 };
 
+
+///	A texture through which shaders can access the contents of a GLBuffer
+/** The buffer has to be of type `GL_TEXTURE_BUFFER`. Inside a shader, its
+ * entries can be read through `texelFetch` on a `samplerBuffer`,
+ * `isamplerBuffer` or `usamplerBuffer`, depending on `internalFormat`.*/
+class GLBufferTexture {
+public:
+	GLBufferTexture () :
+		m_id (0)
+	{
+		glGenTextures (1, &m_id);
+	}
+
+	~GLBufferTexture ()
+	{
+		glDeleteTextures (1, &m_id);
+	}
+
+	///	attaches the given buffer to the texture
+	/** \param internalFormat	e.g. 'GL_R32UI' or 'GL_RGBA32F'*/
+	void set_buffer (const std::shared_ptr <GLBuffer>& buffer, GLenum internalFormat) {
+		COND_THROW (buffer->type() != GL_TEXTURE_BUFFER,
+		            "GLBufferTexture::set_buffer: Buffer has to be of type GL_TEXTURE_BUFFER");
+		m_buffer = buffer;
+		glBindTexture (GL_TEXTURE_BUFFER, m_id);
+		glTexBuffer (GL_TEXTURE_BUFFER, internalFormat, m_buffer->id());
+	}
+
+	const std::shared_ptr <GLBuffer>& buffer () const	{return m_buffer;}
+
+	///	binds the texture to the given texture unit
+	void bind (const uint unit) {
+		glActiveTexture (GL_TEXTURE0 + unit);
+		glBindTexture (GL_TEXTURE_BUFFER, m_id);
+	}
+
+private:
+	uint						m_id;
+	std::shared_ptr <GLBuffer>	m_buffer;
+};
+
 }// end of namespace lumeview
 
 #endif	//__H__lumeview__gl_buffer
@@ -0,0 +1,266 @@
+// This file is part of lumeview, a lightweight viewer for unstructured meshes
+//
+// Copyright (C) 2018 Sebastian Reiter
+// Copyright (C) 2018 G-CSC, Goethe University Frankfurt
+// Author: Sebastian Reiter <s.b.reiter@gmail.com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <limits>
+#include "gl_resource_cache.h"
+
+using namespace std;
+
+namespace lumeview {
+
+static const size_t MAX_NUM_FREE_VAOS = 1024;
+
+GLResourceCache::GLResourceCache () :
+	m_memoryBudget (size_t(512) << 20),
+	m_memoryUsage (0)
+{}
+
+GLResourceCache& GLResourceCache::inst ()
+{
+	static GLResourceCache cache;
+	return cache;
+}
+
+std::shared_ptr <GLBuffer> GLResourceCache::
+find_buffer (const SPSource& source, const int variant, Sphere* boundsOut)
+{
+	if (!source)
+		return nullptr;
+
+	auto& entries = inst().m_entries;
+	auto iter = entries.find (Key (source.get(), variant));
+	if (iter == entries.end())
+		return nullptr;
+
+	Entry& entry = iter->second;
+
+//	the address of a destroyed source may have been reused by a new object.
+	if (entry.source.owner_before (source) || source.owner_before (entry.source)) {
+		inst().remove_entry (iter);
+		return nullptr;
+	}
+
+	auto& lru = inst().m_lru;
+	lru.splice (lru.end(), lru, entry.lruPos);
+	if (boundsOut)
+		*boundsOut = entry.bounds;
+	return entry.buffer;
+}
+
+std::shared_ptr <GLBuffer> GLResourceCache::
+create_buffer (const SPSource& source,
+               const int variant,
+               const GLenum type,
+               const uint size,
+               const Sphere& bounds)
+{
+	GLResourceCache& cache = inst();
+	const Key key (source.get(), variant);
+
+	auto iter = cache.m_entries.find (key);
+	if (iter != cache.m_entries.end())
+		cache.remove_entry (iter);
+
+	auto buf = cache.recycled_buffer (type, size);
+
+	Entry& entry = cache.m_entries [key];
+	entry.source = source;
+	entry.buffer = buf;
+	entry.bounds = bounds;
+	entry.numBytes = buf->capacity();
+	entry.lruPos = cache.m_lru.insert (cache.m_lru.end(), key);
+	cache.m_memoryUsage += entry.numBytes;
+
+	cache.enforce_budget ();
+	return buf;
+}
+
+void GLResourceCache::
+invalidate (const void* source)
+{
+	GLResourceCache& cache = inst();
+	auto& entries = cache.m_entries;
+	auto iter = entries.lower_bound (Key (source, numeric_limits<int>::min()));
+	while (iter != entries.end() && iter->first.source == source)
+		iter = cache.remove_entry (iter);
+}
+
+void GLResourceCache::
+invalidate (const void* source, const int variant)
+{
+	GLResourceCache& cache = inst();
+	auto& entries = cache.m_entries;
+	auto iter = entries.find (Key (source, variant));
+	if (iter != entries.end())
+		cache.remove_entry (iter);
+}
+
+uint GLResourceCache::
+acquire_vao ()
+{
+	auto& freeVAOs = inst().m_freeVAOs;
+	uint vao = 0;
+	if (freeVAOs.empty())
+		glGenVertexArrays (1, &vao);
+	else {
+		vao = freeVAOs.back();
+		freeVAOs.pop_back();
+	}
+	return vao;
+}
+
+void GLResourceCache::
+release_vao (uint vao)
+{
+	if (!vao)
+		return;
+
+	auto& freeVAOs = inst().m_freeVAOs;
+	if (freeVAOs.size() < MAX_NUM_FREE_VAOS)
+		freeVAOs.push_back (vao);
+	else
+		glDeleteVertexArrays (1, &vao);
+}
+
+void GLResourceCache::
+set_memory_budget (const size_t numBytes)
+{
+	inst().m_memoryBudget = numBytes;
+	inst().enforce_budget ();
+}
+
+size_t GLResourceCache::
+memory_budget ()
+{
+	return inst().m_memoryBudget;
+}
+
+size_t GLResourceCache::
+memory_usage ()
+{
+	return inst().m_memoryUsage;
+}
+
+void GLResourceCache::
+clear ()
+{
+	GLResourceCache& cache = inst();
+	cache.m_entries.clear();
+	cache.m_lru.clear();
+	cache.m_freeBuffers.clear();
+	cache.m_memoryUsage = 0;
+	if (!cache.m_freeVAOs.empty()) {
+		glDeleteVertexArrays (GLsizei (cache.m_freeVAOs.size()), cache.m_freeVAOs.data());
+		cache.m_freeVAOs.clear();
+	}
+}
+
+std::shared_ptr <GLBuffer> GLResourceCache::
+recycled_buffer (const GLenum type, const uint size)
+{
+//	find the smallest free buffer of the requested type which is large enough.
+//	If there is none, we'll take the largest one and enlarge it.
+//	Free buffers are sorted by capacity.
+	auto firstFit = lower_bound (m_freeBuffers.begin(), m_freeBuffers.end(), size,
+	                             [] (const shared_ptr<GLBuffer>& b, const uint s)
+	                             {return b->capacity() < s;});
+
+	auto bestFit = find_if (firstFit, m_freeBuffers.end(),
+	                        [type] (const shared_ptr<GLBuffer>& b) {return b->type() == type;});
+
+	if (bestFit == m_freeBuffers.end()) {
+		for(auto iter = firstFit; iter != m_freeBuffers.begin();) {
+			--iter;
+			if ((*iter)->type() == type) {
+				bestFit = iter;
+				break;
+			}
+		}
+	}
+
+	shared_ptr <GLBuffer> buf;
+	if (bestFit != m_freeBuffers.end()) {
+		buf = std::move (*bestFit);
+		m_freeBuffers.erase (bestFit);
+		m_memoryUsage -= buf->capacity();
+	}
+	else
+		buf = make_shared <GLBuffer> (type);
+
+	buf->set_size (size);
+	return buf;
+}
+
+void GLResourceCache::
+recycle (std::shared_ptr <GLBuffer>&& buf)
+{
+//	buffers which are still in use by a renderer can't be recycled.
+	if (buf && buf.use_count() == 1) {
+		m_memoryUsage += buf->capacity();
+		auto pos = upper_bound (m_freeBuffers.begin(), m_freeBuffers.end(), buf,
+		                        [] (const shared_ptr<GLBuffer>& b0, const shared_ptr<GLBuffer>& b1)
+		                        {return b0->capacity() < b1->capacity();});
+		m_freeBuffers.insert (pos, std::move (buf));
+	}
+	buf.reset ();
+}
+
+GLResourceCache::EntryIter GLResourceCache::
+remove_entry (EntryIter iter)
+{
+//	the buffer may have been enlarged by its users in the meantime. It is
+//	counted with its current capacity if it is recycled.
+	m_memoryUsage -= iter->second.numBytes;
+	m_lru.erase (iter->second.lruPos);
+	recycle (std::move (iter->second.buffer));
+	return m_entries.erase (iter);
+}
+
+void GLResourceCache::
+enforce_budget ()
+{
+//	free buffers are released first, starting with the largest ones
+	while (m_memoryUsage > m_memoryBudget && !m_freeBuffers.empty()) {
+		m_memoryUsage -= m_freeBuffers.back()->capacity();
+		m_freeBuffers.pop_back();
+	}
+
+//	now release the least recently used buffers which are not in use
+	for(auto lruIter = m_lru.begin();
+	    m_memoryUsage > m_memoryBudget && lruIter != m_lru.end();)
+	{
+		auto iter = m_entries.find (*lruIter);
+		++lruIter;
+		if (iter->second.buffer.use_count() == 1) {
+			m_memoryUsage -= iter->second.numBytes;
+			m_lru.erase (iter->second.lruPos);
+			m_entries.erase (iter);
+		}
+	}
+}
+
+}// end of namespace lumeview
@@ -0,0 +1,143 @@
+// This file is part of lumeview, a lightweight viewer for unstructured meshes
+//
+// Copyright (C) 2018 Sebastian Reiter
+// Copyright (C) 2018 G-CSC, Goethe University Frankfurt
+// Author: Sebastian Reiter <s.b.reiter@gmail.com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __H__lumeview__gl_resource_cache
+#define __H__lumeview__gl_resource_cache
+
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "gl_buffer.h"
+#include "shapes.h"
+
+namespace lumeview {
+
+///	A process wide cache for OpenGL buffers and vertex array objects
+/** Buffers are associated with the object from which their data was
+ * created (e.g. a `RealArrayAnnex` holding coordinates or a `Mesh` whose
+ * grobs were uploaded as indices). Renderers which display data of the same
+ * source can thus share a single buffer and a buffer survives the destruction
+ * of the renderer which created it, so that identical data has not to be
+ * uploaded again, e.g. after a visualization was refreshed.
+ *
+ * A buffer is in use as long as a shared pointer returned by `find_buffer` or
+ * `create_buffer` exists outside of the cache. Unused buffers are kept until
+ * the total amount of buffer memory exceeds the memory budget
+ * (see `set_memory_budget`). In that case the least recently used unused
+ * buffers are released.
+ *
+ * \note	The cache can't detect in-place changes of a source object. If the
+ *			data of a source changes, `invalidate` has to be called for that source.
+ *
+ * \note	All methods have to be called from the thread which owns the OpenGL context.
+ */
+class GLResourceCache {
+public:
+	using SPSource = std::shared_ptr <const void>;
+
+	///	returns the buffer for the given source and variant or nullptr if no such buffer is cached.
+	/** `variant` can be used to associate different buffers with the same source
+	 * object. If `boundsOut` is specified and a buffer was found, the bounds which
+	 * were set during `create_buffer` are written to it.*/
+	static std::shared_ptr <GLBuffer>
+	find_buffer (const SPSource& source, const int variant = 0, Sphere* boundsOut = nullptr);
+
+	///	creates a new buffer of the given size for the specified source and variant.
+	/** If possible, a previously released buffer is recycled. The data of the
+	 * returned buffer is undefined and has to be set by the caller.
+	 * \note an existing buffer of the same source and variant is replaced.*/
+	static std::shared_ptr <GLBuffer>
+	create_buffer (const SPSource& source,
+	               const int variant,
+	               const GLenum type,
+	               const uint size,
+	               const Sphere& bounds = Sphere ());
+
+	///	removes all buffers associated with the given source from the cache
+	/** Buffers which are currently in use stay valid for their users but are
+	 * no longer returned by `find_buffer`.*/
+	static void invalidate (const void* source);
+
+	///	removes the buffer associated with the given source and variant from the cache
+	/** Other buffers of the same source are kept (see `invalidate`).*/
+	static void invalidate (const void* source, const int variant);
+
+	///	returns a vertex array object. Use `release_vao` to return it to the cache.
+	static uint acquire_vao ();
+	static void release_vao (uint vao);
+
+	///	sets the maximal amount of memory in bytes which may be occupied by cached buffers.
+	/** Buffers which are in use are never released, so the budget may be exceeded
+	 * temporarily. The default budget is 512 MB.*/
+	static void set_memory_budget (const size_t numBytes);
+	static size_t memory_budget ();
+
+	///	returns the total amount of memory in bytes occupied by all cached buffers
+	static size_t memory_usage ();
+
+	///	releases all OpenGL objects which are not in use. Call before the OpenGL context is destroyed.
+	static void clear ();
+
+private:
+	struct Key {
+		Key (const void* _source, int _variant) : source (_source), variant (_variant) {}
+		bool operator < (const Key& k) const	{return source < k.source || (source == k.source && variant < k.variant);}
+
+		const void*	source;
+		int			variant;
+	};
+
+	struct Entry {
+		std::weak_ptr <const void>		source;
+		std::shared_ptr <GLBuffer>		buffer;
+		Sphere							bounds;
+		size_t							numBytes;	///< capacity of `buffer` as counted in `m_memoryUsage`
+		std::list <Key>::iterator		lruPos;		///< position in `m_lru`
+	};
+
+	using EntryIter = std::map <Key, Entry>::iterator;
+
+	GLResourceCache ();
+	static GLResourceCache& inst ();
+
+	std::shared_ptr <GLBuffer> recycled_buffer (const GLenum type, const uint size);
+	void recycle (std::shared_ptr <GLBuffer>&& buf);
+	EntryIter remove_entry (EntryIter iter);
+	void enforce_budget ();
+
+	std::map <Key, Entry>						m_entries;
+	std::list <Key>								m_lru;			///< keys of `m_entries`, least recently used first
+	std::vector <std::shared_ptr <GLBuffer>>	m_freeBuffers;	///< sorted by capacity
+	std::vector <uint>							m_freeVAOs;
+	size_t										m_memoryBudget;
+	size_t										m_memoryUsage;
+};
+
+}// end of namespace lumeview
+
+#endif	//__H__lumeview__gl_resource_cache
@@ -24,6 +24,7 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
 // THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <cstring>
 #include <iostream>
 
 #include <glad/glad.h>	// include before other OpenGL related includes
@@ -134,9 +135,21 @@ int main (int argc, char** argv)
 
 		LumeviewInit ();
 		
-	//	if a filename was specified, we'll load that, if not, we'll create a sample scene
-		if (argc == 2)
-			g_lumeview.set_scene (CreateSceneForMesh (argv[1]));
+	//	usage: lumeview [--cache] [filename]
+	//	'--cache' stores the loaded mesh and its visualization data in files
+	//	next to the mesh file and loads them from there on later runs.
+		const char* filename = nullptr;
+		for(int i = 1; i < argc; ++i) {
+			if (strcmp (argv[i], "--cache") == 0)
+				g_lumeview.set_use_cache (true);
+			else
+				filename = argv[i];
+		}
+
+	//	if a filename was specified, we'll load that in the background,
+	//	if not, we'll create a sample scene
+		if (filename)
+			g_lumeview.load_scene_async (filename);
 		else
 			g_lumeview.set_scene (CreateSampleScene ());
 
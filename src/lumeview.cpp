@@ -25,6 +25,7 @@
 // THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
+#include <cstdio>
 #include <string>
 
 #include <glad/glad.h>	// include before other OpenGL related includes
@@ -33,6 +34,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/io.hpp>
 
+#include "gl_resource_cache.h"
 #include "log.h"
 #include "lumeview.h"
 #include "imgui/imgui.h"
@@ -74,6 +76,7 @@ void LumeviewInit ()
 
 void LumeviewShutdown ()
 {
+	GLResourceCache::clear ();
 	ImGui_Shutdown ();
 }
 
@@ -83,10 +86,18 @@ void LumeviewShutdown ()
 
 void Lumeview::clear ()
 {
+//	pending loaders are joined on destruction, which blocks until their loading
+//	threads reach the next progress report. All of them are cancelled first,
+//	so that they stop concurrently. `process_scene_loaders` only removes
+//	loaders which have finished and thus never blocks.
+	for(auto& loader : m_sceneLoaders)
+		loader->cancel ();
+	m_sceneLoaders.clear();
 	m_scene.reset();
 }
 
 Lumeview::Lumeview () :
+	m_useCache (false),
 	m_guiShowScene (true),
 	m_guiShowLog (true),
 	m_guiShowDemo (false)
@@ -164,6 +175,66 @@ void Lumeview::set_scene (const SPScene& scene)
 	m_scene = scene;
 }
 
+void Lumeview::load_scene_async (const std::string& filename)
+{
+	LOG ("Loading '" << filename << "'\n");
+	m_sceneLoaders.push_back (make_shared <SceneLoader> (filename, m_useCache));
+}
+
+void Lumeview::process_scene_loaders ()
+{
+	if (m_sceneLoaders.empty ())
+		return;
+
+	ImGui::Begin ("Loading", NULL, ImGuiWindowFlags_AlwaysAutoResize);
+
+	for(auto iloader = m_sceneLoaders.begin(); iloader != m_sceneLoaders.end();) {
+		SceneLoader& loader = **iloader;
+		const SceneLoader::State state = loader.state ();
+
+		if (state == SceneLoader::LOADING) {
+			const SceneLoadProgress progress = loader.progress ();
+			float fraction = 0;
+			char overlay [64];
+			if (progress.bytesTotal > 0) {
+				fraction = float (double (progress.bytesDone) / double (progress.bytesTotal));
+				snprintf (overlay, sizeof (overlay), "%s %d%%",
+				          progress.phase.c_str(), int (fraction * 100.f));
+			}
+			else
+				snprintf (overlay, sizeof (overlay), "%s", progress.phase.c_str());
+
+			ImGui::PushID (&loader);
+			ImGui::TextUnformatted (loader.filename ().c_str());
+			ImGui::ProgressBar (fraction, ImVec2 (300.f, 0.f), overlay);
+			if (loader.cancel_requested ())
+				ImGui::TextDisabled ("cancelling...");
+			else if (ImGui::Button ("Cancel"))
+				loader.cancel ();
+			ImGui::PopID ();
+
+			++iloader;
+			continue;
+		}
+
+	//	the loading thread has finished, so that removing the loader doesn't block
+		if (state == SceneLoader::FINISHED) {
+			set_scene (loader.scene ());
+			LOG ("Loaded '" << loader.filename () << "'\n");
+		}
+		else if (state == SceneLoader::FAILED) {
+			LOG ("ERROR: Loading '" << loader.filename () << "' failed:\n"
+			     << loader.error_message () << "\n");
+		}
+		else
+			LOG ("Loading '" << loader.filename () << "' was cancelled\n");
+
+		iloader = m_sceneLoaders.erase (iloader);
+	}
+
+	ImGui::End ();
+}
+
 void Lumeview::process_gui ()
 {
 	lumeview::ImGui_NewFrame();
@@ -189,6 +260,8 @@ void Lumeview::process_gui ()
 	if (m_guiShowScene && m_scene)
 		m_scene->do_imgui (&m_guiShowScene);
 
+	process_scene_loaders ();
+
 	ImGui::Render();
 
 	MessageQueue::dispatch ();
@@ -28,8 +28,11 @@
 #ifndef __H__lumeview_lumeview
 #define __H__lumeview_lumeview
 
+#include <string>
+#include <vector>
 #include "arc_ball_view.h"
 #include "scene.h"
+#include "scene_loader.h"
 #include "window_event_listener.h"
 
 namespace lumeview {
@@ -44,6 +47,9 @@ public:
 
 	Lumeview ();
 
+	/// releases the scene and cancels pending loaders
+	/** Blocks until the loading threads of pending loaders have stopped (see
+	 * `SceneLoader::~SceneLoader`).*/
 	void clear();
 	
 	// OVERRIDES FOR WindowEventListener
@@ -58,6 +64,19 @@ public:
 
   	void set_scene (const SPScene& scene);
 
+  	/// Loads the given mesh file on a background thread and shows it once it is loaded
+  	/** The progress of each pending load is shown in a window, from which it
+  	 * can also be cancelled. The current scene stays interactive meanwhile.
+  	 * Several files may be loaded concurrently, each replaces the current
+  	 * scene once it is loaded.*/
+  	void load_scene_async (const std::string& filename);
+
+  	/// Enables caching of loaded meshes and their visualization data next to the mesh files
+  	/** Disabled by default. Only affects files which are loaded afterwards.
+  	 * \sa CreateSceneForMesh*/
+  	void set_use_cache (const bool useCache)	{m_useCache = useCache;}
+  	bool use_cache () const						{return m_useCache;}
+
   	void process_gui ();
 
   	void render ();
@@ -65,11 +84,15 @@ public:
 private:
 	using base_t = WindowEventListener;
 
+	void process_scene_loaders ();
+
 	WindowEventListener* m_imguiListener;
 	ArcBallView			 m_arcBallView;
 
 	SPScene				 m_scene;
+	std::vector <SPSceneLoader>	m_sceneLoaders;
 
+	bool	m_useCache;
 	bool	m_guiShowScene;
 	bool	m_guiShowLog;
 	bool	m_guiShowDemo;
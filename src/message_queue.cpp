@@ -33,6 +33,10 @@ using namespace std;
 
 namespace lumeview {
 
+//	receivers created on the current thread are collected here during a
+//	deferred registration (see `begin_deferred_registration`)
+static thread_local vector <MessageReceiver*>* t_deferredReceivers = nullptr;
+
 MessageQueue::MessageQueue ()
 {}
 
@@ -44,11 +48,16 @@ MessageQueue& MessageQueue::inst()
 
 void MessageQueue::post (const std::shared_ptr <const Message>& msg)
 {
+	lock_guard <recursive_mutex> lock (inst().m_mutex);
 	inst().m_messages.push (msg);
 }
 
 void MessageQueue::dispatch ()
 {
+//	receivers may post messages or create further receivers during dispatch.
+//	Other threads have to wait until dispatch is complete.
+	lock_guard <recursive_mutex> lock (inst().m_mutex);
+
 	auto& receivers = inst().m_receivers;
 	for(auto& receiver : receivers)
 		receiver->message_dispatch_begins ();
@@ -67,15 +76,48 @@ void MessageQueue::dispatch ()
 
 void MessageQueue::add_receiver (MessageReceiver* rec)
 {
+	if (t_deferredReceivers) {
+		t_deferredReceivers->push_back (rec);
+		return;
+	}
+
+	lock_guard <recursive_mutex> lock (inst().m_mutex);
 	inst().m_receivers.push_back (rec);
 }
 
 void MessageQueue::remove_receiver (MessageReceiver* rec)
 {
+	if (t_deferredReceivers) {
+		auto& deferred = *t_deferredReceivers;
+		auto it = find (deferred.begin(), deferred.end(), rec);
+		if (it != deferred.end()) {
+			deferred.erase (it);
+			return;
+		}
+	}
+
+	lock_guard <recursive_mutex> lock (inst().m_mutex);
 	auto& receivers = inst().m_receivers;
 	auto it = find (receivers.begin(), receivers.end(), rec);
 	if (it != receivers.end())
 		receivers.erase (it);
 }
 
+void MessageQueue::begin_deferred_registration (std::vector <MessageReceiver*>& receiversOut)
+{
+	t_deferredReceivers = &receiversOut;
+}
+
+void MessageQueue::end_deferred_registration ()
+{
+	t_deferredReceivers = nullptr;
+}
+
+void MessageQueue::add_receivers (const std::vector <MessageReceiver*>& receivers)
+{
+	lock_guard <recursive_mutex> lock (inst().m_mutex);
+	auto& r = inst().m_receivers;
+	r.insert (r.end(), receivers.begin(), receivers.end());
+}
+
 }//	end of namespace lumeview
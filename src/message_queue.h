@@ -28,7 +28,9 @@
 #define __H__lumeview_message_queue
 
 #include <memory>
+#include <mutex>
 #include <queue>
+#include <vector>
 
 namespace lumeview {
 
@@ -51,12 +53,25 @@ public:
 
 	static void remove_receiver (MessageReceiver* rec);
 
+	/// Collects receivers which are created on the calling thread instead of registering them
+	/** Until `end_deferred_registration` is called on the same thread, receivers
+	 * which are constructed on the calling thread are appended to `receiversOut`
+	 * and don't receive any messages. This allows to create receivers on a worker
+	 * thread while messages are dispatched on the main thread. Once they are
+	 * ready, the collected receivers are registered through `add_receivers`.*/
+	static void begin_deferred_registration (std::vector <MessageReceiver*>& receiversOut);
+
+	static void end_deferred_registration ();
+
+	static void add_receivers (const std::vector <MessageReceiver*>& receivers);
+
 private:
 	MessageQueue ();
 	static MessageQueue& inst();
 	
 	std::queue <std::shared_ptr <const Message>>	m_messages;
 	std::vector <MessageReceiver*> m_receivers;
+	std::recursive_mutex	m_mutex;
 };
 
 }//	end of namespace lumeview
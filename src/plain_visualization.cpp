@@ -25,6 +25,10 @@
 // THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "plain_visualization.h"
+#include "gl_resource_cache.h"
+#include "visualization_cache.h"
+#include "lume/binary_mesh_file.h"
+#include "lume/neighborhoods.h"
 #include "lume/rim_mesh.h"
 #include "lume/normals.h"
 #include "lume/topology.h"
@@ -33,66 +37,150 @@ using namespace lume;
 using namespace std;
 
 namespace lumeview {
+
+//	identifies the layout of cached rim meshes. Change it whenever the way in
+//	which rim meshes are created changes.
+static const char* RIM_MESH_CACHE_TAG = "PlainVisualization/rimMesh/1";
 	
 PlainVisualization::
-PlainVisualization ()
+PlainVisualization () :
+	m_meshHash (0),
+	m_meshHashValid (false),
+	m_rendererOutdated (false)
 {
 }
 
 PlainVisualization::
-PlainVisualization (const lume::SPMesh& mesh)
+PlainVisualization (const lume::SPMesh& mesh,
+                    std::string cacheFilename,
+                    const lume::LoadProgressCallback& progress) :
+	m_cacheFilename (std::move (cacheFilename)),
+	m_progress (progress),
+	m_meshHash (0),
+	m_meshHashValid (false),
+	m_rendererOutdated (false)
 {
 	set_mesh (mesh);
+//	the callback may refer to the creator of the visualization, which doesn't
+//	outlive the construction (e.g. `SceneLoader`)
+	m_progress = lume::LoadProgressCallback ();
 }
 
 void PlainVisualization::
 set_mesh (const lume::SPMesh& mesh)
 {
 	m_mesh = mesh;
+	m_meshHashValid = false;
 	refresh();
 }
 
+void PlainVisualization::
+set_cache_filename (std::string cacheFilename)
+{
+	m_cacheFilename = std::move (cacheFilename);
+}
+
+SPMesh PlainVisualization::
+create_volume_rim_mesh ()
+{
+	uint64_t cacheKey = 0;
+	if (!m_cacheFilename.empty ()) {
+	//	the contents of the mesh don't change between refreshes
+		if (!m_meshHashValid) {
+			ReportVisualizationProgress (m_progress, "hashing mesh");
+			m_meshHash = HashMeshContents (*m_mesh);
+			m_meshHashValid = true;
+		}
+		cacheKey = VisualizationCacheKey (RIM_MESH_CACHE_TAG, m_meshHash);
+		ReportVisualizationProgress (m_progress, "reading visualization cache");
+		if (auto bndMesh = LoadVisualizationCache (m_cacheFilename, cacheKey, m_mesh->coords()))
+			return bndMesh;
+	}
+
+	ReportVisualizationProgress (m_progress, "creating rim");
+	auto bndMesh = make_shared <Mesh> ();
+	CreateRimMesh (*bndMesh, *m_mesh, Neighborhoods (m_mesh, FACES, CELLS),
+	               [] (const GrobIndex&) {return true;});
+	ReportVisualizationProgress (m_progress, "computing normals");
+	ComputeFaceVertexNormals3 (*bndMesh, "normals");
+	CreateSideGrobs (*bndMesh, 1);
+
+	if (!m_cacheFilename.empty ()) {
+		ReportVisualizationProgress (m_progress, "writing visualization cache");
+		StoreVisualizationCache (m_cacheFilename, cacheKey, *bndMesh);
+	}
+
+	return bndMesh;
+}
+
 void PlainVisualization::
 refresh ()
+{
+	m_surfaceMesh.reset ();
+	m_bndMesh.reset ();
+//	stages are created on the rendering thread (see `render`), so that
+//	visualizations may be created on other threads.
+	m_rendererOutdated = true;
+
+	if (m_mesh->has (CELLS))
+		m_surfaceMesh = create_volume_rim_mesh ();
+
+	else if (m_mesh->has (FACES)) {
+		ReportVisualizationProgress (m_progress, "computing normals");
+		ComputeFaceVertexNormals3 (*m_mesh, "normals");
+		CreateSideGrobs (*m_mesh, 1);
+		m_surfaceMesh = m_mesh;
+		m_bndMesh = make_shared <Mesh> ();
+		CreateRimMesh (*m_bndMesh, *m_mesh, Neighborhoods (m_mesh, EDGES, FACES),
+		               [] (const GrobIndex&) {return true;});
+	}
+	else if (m_mesh->has (EDGES)) {
+		ComputeFaceVertexNormals3 (*m_mesh, "normals");
+		m_surfaceMesh = m_mesh;
+	}
+}
+
+void PlainVisualization::
+prepare_renderer ()
 {
 	m_renderer.clear();
+	m_rendererOutdated = false;
+
+	if (!m_surfaceMesh)
+		return;
 
 	const glm::vec4 solidColor (1.0f, 0.843f, 0.f, 1.0f);
 	const glm::vec4 wireColor (0.2f, 0.2f, 0.2f, 1.0f);
 	const glm::vec4 bndColor (1.0f, 0.2f, 0.2f, 1.0f);
 
-	if (m_mesh->has (CELLS)) {
-		auto bndMesh = CreateRimMesh (m_mesh, CELLS);
-		ComputeFaceVertexNormals3 (*bndMesh, "normals");
-		CreateSideGrobs (*bndMesh, 1);
-		m_renderer.add_stage ("solid", bndMesh, FACES, FLAT);
+//	grobs and normals of the visualized mesh may have been changed in-place,
+//	so that buffers created from earlier contents are outdated
+	GLResourceCache::invalidate (m_surfaceMesh.get());
+	GLResourceCache::invalidate (m_surfaceMesh->optional_annex<RealArrayAnnex>("normals", VERTEX).get());
+
+	if (m_surfaceMesh->has (FACES)) {
+		m_renderer.add_stage ("solid", m_surfaceMesh, FACES, FLAT);
 		m_renderer.stage_set_color (solidColor);
-		m_renderer.add_stage ("wire", bndMesh, EDGES, FLAT);
+		m_renderer.add_stage ("wire", m_surfaceMesh, EDGES, FLAT);
 		m_renderer.stage_set_color (wireColor);
 	}
-	else if (m_mesh->has (FACES)) {
-		ComputeFaceVertexNormals3 (*m_mesh, "normals");
-		CreateSideGrobs (*m_mesh, 1);
-		m_renderer.add_stage ("solid", m_mesh, FACES, FLAT);
-		m_renderer.stage_set_color (solidColor);
-		m_renderer.add_stage ("wire", m_mesh, EDGES, FLAT);
+	else {
+		m_renderer.add_stage ("wire", m_surfaceMesh, EDGES, NONE);
 		m_renderer.stage_set_color (wireColor);
-		auto bndMesh = CreateRimMesh (m_mesh, FACES);
-		if (bndMesh->has (EDGES)) {
-			m_renderer.add_stage ("bnd", bndMesh, EDGES, NONE);
-			m_renderer.stage_set_color (bndColor);
-		}
 	}
-	else if (m_mesh->has (EDGES)) {
-		ComputeFaceVertexNormals3 (*m_mesh, "normals");
-		m_renderer.add_stage ("wire", m_mesh, EDGES, NONE);
-		m_renderer.stage_set_color (wireColor);
+
+	if (m_bndMesh && m_bndMesh->has (EDGES)) {
+		m_renderer.add_stage ("bnd", m_bndMesh, EDGES, NONE);
+		m_renderer.stage_set_color (bndColor);
 	}
 }
 
 void PlainVisualization::
 render (const View& view)
 {
+	if (m_rendererOutdated)
+		prepare_renderer ();
+
 	m_renderer.render (view);
 }
 
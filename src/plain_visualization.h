@@ -27,6 +27,8 @@
 #ifndef __H__lumeview_plain_visualization
 #define __H__lumeview_plain_visualization
 
+#include <cstdint>
+#include <string>
 #include "lume/mesh.h"
 #include "renderer.h"
 #include "visualization.h"
@@ -38,10 +40,26 @@ class PlainVisualization : public Visualization
 {
 public:
 	PlainVisualization ();
-	PlainVisualization (const lume::SPMesh& mesh);
+
+	/// \param cacheFilename	(optional) see `set_cache_filename`
+	/// \param progress		(optional) receives the phases of the initial `refresh`.
+	///						Returning false cancels the construction through a
+	///						`lume::LoadCancelledError`.
+	PlainVisualization (const lume::SPMesh& mesh,
+	                    std::string cacheFilename = std::string (),
+	                    const lume::LoadProgressCallback& progress = lume::LoadProgressCallback ());
 	
 	void set_mesh (const lume::SPMesh& mesh);
 
+	/// Sets the sidecar file in which derived data is cached (see visualization_cache.h)
+	/** The rim of a volume mesh including its edges and normals is loaded from
+	 * this file during `refresh`, if it was stored for the same mesh contents.
+	 * Otherwise it is recreated and stored. Caching is disabled for an empty filename.*/
+	void set_cache_filename (std::string cacheFilename);
+
+	/// Recreates the data which is displayed
+	/** Doesn't access OpenGL. The stages of the renderer are recreated during
+	 * the next call to `render`.*/
 	void refresh ();
 
 	void render (const View& view) override;
@@ -49,8 +67,19 @@ public:
 	glm::vec2 estimate_z_clip_dists (const View& view) const override;
 
 private:
+	lume::SPMesh create_volume_rim_mesh ();
+	void prepare_renderer ();
+
 	Renderer					m_renderer;
 	lume::SPMesh				m_mesh;
+	lume::SPMesh				m_surfaceMesh;
+	lume::SPMesh				m_bndMesh;
+	std::string					m_cacheFilename;
+//	only set during construction, see the constructor
+	lume::LoadProgressCallback	m_progress;
+	uint64_t					m_meshHash;
+	bool						m_meshHashValid;
+	bool						m_rendererOutdated;
 };
 	
 }//	end of namespace lumeview
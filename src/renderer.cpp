@@ -40,12 +40,16 @@ static const char* shadingNames[] = {"none", "flat", "smooth"};
 
 Renderer::
 Renderer() :
-	m_shaderPath (SHADER_PATH)
+	m_buffersDirty (false),
+	m_shaderPath (SHADER_PATH),
+	m_subsetTableDirty (false)
 {}
 
 Renderer::
 Renderer(std::string shaderPath) :
-	m_shaderPath (std::move (shaderPath))
+	m_buffersDirty (false),
+	m_shaderPath (std::move (shaderPath)),
+	m_subsetTableDirty (false)
 {
 }
 
@@ -53,6 +57,7 @@ void Renderer::
 clear ()
 {
 	m_stages.clear();
+	m_buffersDirty = false;
 }
 
 void Renderer::
@@ -74,7 +79,6 @@ add_stage (	std::string name,
 			newStage.color = glm::vec4 (0.2f, 0.2f, 1.0f, 0.5f);
 			newStage.zfacNear = 0.99f;
 			newStage.zfacFar = 1.f;
-			newStage.numInds = mesh->num_indices (EDGE);
 			break;
 		
 		case TRIS:
@@ -84,8 +88,6 @@ add_stage (	std::string name,
 			newStage.color = glm::vec4 (1.0f, 1.0f, 1.0f, 1.0f);
 			newStage.zfacNear = 1.0f;
 			newStage.zfacFar = 1.0f;
-			newStage.numInds = mesh->num_indices(TRI)
-					 		 + 3 * mesh->num_indices(QUAD) / 2;
 			break;
 		default:
 			THROW("Renderer::add_stage: Unsupported grid object type in specified mesh.");
@@ -95,6 +97,7 @@ add_stage (	std::string name,
 	newStage.name = std::move (name);
 	newStage.grobSet = grobSet;
 	m_stages.push_back (std::move(newStage));
+	m_buffersDirty = true;
 }
 
 Renderer::Stage&
@@ -121,6 +124,118 @@ stage_set_color (const glm::vec4& color, int stageInd)
 	stage (stageInd).color = color;
 }
 
+void Renderer::
+stage_set_subset_annex (const std::string& annexName, int stageInd)
+{
+	Stage& s = stage (stageInd);
+	for(auto gt : s.grobSet) {
+		COND_THROW (!s.mesh->has_annex <IndexArrayAnnex> (annexName, gt),
+		            "Renderer::stage_set_subset_annex: Annex '" << annexName
+		            << "' is not provided for grob type '" << GrobName (gt)
+		            << "' by the mesh of stage '" << s.name << "'.");
+	}
+
+	s.subsetAnnexName = annexName;
+	s.primSubsets.reset ();
+	s.dirty = true;
+	m_buffersDirty = true;
+}
+
+void Renderer::
+set_subset_colors (std::vector <glm::vec4> colors)
+{
+	m_subsetColors = std::move (colors);
+	m_subsetVisibilities.resize (m_subsetColors.size(), 1);
+	m_subsetTableDirty = true;
+}
+
+void Renderer::
+set_subset_color (const index_t si, const glm::vec4& color)
+{
+	if (si >= m_subsetColors.size()) {
+		m_subsetColors.resize (si + 1, glm::vec4 (1.f));
+		m_subsetVisibilities.resize (si + 1, 1);
+		m_subsetTableDirty = true;
+	}
+
+	m_subsetColors [si] = color;
+
+	if (!m_subsetTableDirty && m_subsetColorTex) {
+		m_subsetColorTex->buffer()->set_sub_data (
+		                uint (si * sizeof (glm::vec4)),
+		                glm::value_ptr (color),
+		                uint (sizeof (glm::vec4)));
+	}
+}
+
+void Renderer::
+set_subset_visible (const index_t si, const bool visible)
+{
+	if (si >= m_subsetColors.size()) {
+		m_subsetColors.resize (si + 1, glm::vec4 (1.f));
+		m_subsetVisibilities.resize (si + 1, 1);
+		m_subsetTableDirty = true;
+	}
+
+	const uint8_t v = visible ? 1 : 0;
+	m_subsetVisibilities [si] = v;
+
+	if (!m_subsetTableDirty && m_subsetVisibilityTex) {
+		m_subsetVisibilityTex->buffer()->set_sub_data (
+		                uint (si * sizeof (uint8_t)), &v, uint (sizeof (uint8_t)));
+	}
+}
+
+void Renderer::
+invalidate_stage (int stageInd)
+{
+	Stage& s = stage (stageInd);
+
+//	the data of the stage's mesh may have changed in-place, so that cached
+//	buffers which were created from that data are outdated, too.
+	GLResourceCache::invalidate (s.mesh->coords().get());
+	GLResourceCache::invalidate (s.mesh->optional_annex<RealArrayAnnex>("normals", VERTEX).get());
+	GLResourceCache::invalidate (s.mesh.get());
+
+	s.dirty = true;
+	s.coordBuf.reset ();
+	s.normBuf.reset ();
+	s.indBuf.reset ();
+	s.primSubsets.reset ();
+	m_buffersDirty = true;
+}
+
+void Renderer::
+invalidate_stage_grobs (int stageInd)
+{
+	Stage& s = stage (stageInd);
+
+	GLResourceCache::invalidate (s.mesh.get(), s.grobSet.type());
+
+	s.dirty = true;
+	s.indBuf.reset ();
+	m_buffersDirty = true;
+}
+
+void Renderer::
+invalidate_stage_normals (int stageInd)
+{
+	Stage& s = stage (stageInd);
+
+	GLResourceCache::invalidate (s.mesh->optional_annex<RealArrayAnnex>("normals", VERTEX).get());
+
+	s.dirty = true;
+	s.normBuf.reset ();
+	m_buffersDirty = true;
+}
+
+void Renderer::
+invalidate ()
+{
+	for(size_t i = 0; i < m_stages.size(); ++i)
+		invalidate_stage ((int)i);
+}
+
 glm::vec2 Renderer::
 estimate_z_clip_dists (const View& view) const
 {
@@ -151,140 +266,255 @@ estimate_z_clip_dists (const View& view) const
 void Renderer::
 prepare_buffers ()
 {
-	for(size_t istage = 0; istage < m_stages.size(); ++istage) {
-		Stage& curStage = m_stages[istage];
-		SPMesh mesh = curStage.mesh;
-
-		//	create the vertex array object for this stage
-		glBindVertexArray (curStage.vao);
+	if (!m_buffersDirty)
+		return;
 
-		const bool curMeshNeedsVrtNormals =
-					(curStage.shadingPreset == SMOOTH)
-				||	(curStage.grobSet.type() == EDGES && (curStage.shadingPreset == FLAT));
-
-		COND_THROW(curMeshNeedsVrtNormals && !mesh->has_annex<RealArrayAnnex>("normals", VERTEX),
-		           "Requested shader needs normal information!");
+	for(size_t istage = 0; istage < m_stages.size(); ++istage) {
+		if (m_stages[istage].dirty)
+			prepare_stage (istage);
+	}
 
-		//	check whether we can reuse buffer objects
-		for(size_t iOtherStage = 0; iOtherStage < istage; ++iOtherStage) {
-			Stage& stage = m_stages[iOtherStage];
+	m_buffersDirty = false;
+}
 
-			if (stage.mesh->coords() == mesh->coords()) {
-				curStage.coordBuf = stage.coordBuf;
-				curStage.bndSphere = stage.bndSphere;
-			}
+void Renderer::
+prepare_stage (const size_t istage)
+{
+	Stage& curStage = m_stages[istage];
+	SPMesh mesh = curStage.mesh;
+
+	if (curStage.grobSet.type() == EDGES)
+		curStage.numInds = mesh->num_indices (EDGE);
+	else
+		curStage.numInds = mesh->num_indices(TRI)
+				 		 + 3 * mesh->num_indices(QUAD) / 2;
+
+	//	create the vertex array object for this stage
+	glBindVertexArray (curStage.vao);
+
+	const bool curMeshNeedsVrtNormals =
+				(curStage.shadingPreset == SMOOTH)
+			||	(curStage.grobSet.type() == EDGES && (curStage.shadingPreset == FLAT));
+
+	COND_THROW(curMeshNeedsVrtNormals && !mesh->has_annex<RealArrayAnnex>("normals", VERTEX),
+	           "Requested shader needs normal information!");
+
+	//	coordinates
+	if (!curStage.coordBuf) {
+		SPRealArrayAnnex coords = mesh->coords();
+		curStage.coordBuf = GLResourceCache::find_buffer (coords, 0, &curStage.bndSphere);
+		if (!curStage.coordBuf) {
+			curStage.bndSphere = SphereFromCoords (UNPACK_DST(*coords));
+			curStage.coordBuf = GLResourceCache::create_buffer (
+			                        coords, 0, GL_ARRAY_BUFFER,
+			                        uint (sizeof(real_t) * coords->size()),
+			                        curStage.bndSphere);
+			curStage.coordBuf->set_data (coords->raw_ptr(),
+			                             uint (sizeof(real_t) * coords->size()));
+		}
+	}
 
-			if (curMeshNeedsVrtNormals && stage.mesh->has_annex<RealArrayAnnex>("normals", VERTEX)
-			    && stage.mesh->annex<RealArrayAnnex>("normals", VERTEX) == mesh->annex<RealArrayAnnex>("normals", VERTEX))
-			{
-				curStage.normBuf = stage.normBuf;
+	curStage.coordBuf->bind ();
+	glVertexAttribPointer (0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray (0);
+
+	//	normals
+	if (curMeshNeedsVrtNormals) {
+		if (!curStage.normBuf) {
+			auto normals = mesh->annex<RealArrayAnnex>("normals", VERTEX);
+			curStage.normBuf = GLResourceCache::find_buffer (normals);
+			if (!curStage.normBuf) {
+				curStage.normBuf = GLResourceCache::create_buffer (
+				                        normals, 0, GL_ARRAY_BUFFER,
+				                        uint (sizeof(real_t) * normals->size()));
+				curStage.normBuf->set_data (normals->raw_ptr(),
+				                            uint (sizeof(real_t) * normals->size()));
 			}
+		}
 
-			if (stage.mesh == mesh && stage.grobSet == curStage.grobSet) {
-				curStage.indBuf = stage.indBuf;
-				break;
+		curStage.normBuf->bind ();
+		glVertexAttribPointer (1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray (1);
+	}
+	else
+		glDisableVertexAttribArray (1);
+
+	//	indices
+	if (!curStage.indBuf)
+		curStage.indBuf = GLResourceCache::find_buffer (mesh, curStage.grobSet.type());
+
+	if (curStage.indBuf)
+		curStage.indBuf->bind ();
+	else {
+		curStage.indBuf = GLResourceCache::create_buffer (
+		                        mesh, curStage.grobSet.type(), GL_ELEMENT_ARRAY_BUFFER,
+		                        uint (curStage.numInds * sizeof (index_t)));
+		curStage.indBuf->bind ();
+		const GrobSet gs = curStage.grobSet;
+		
+		uint fill = 0;
+		for(auto gt : gs) {
+			if (mesh->grobs(gt).empty())
+				continue;
+
+			switch (gt) {
+				case EDGE:
+				case TRI:
+					curStage.indBuf->set_sub_data (
+					                fill,
+					                mesh->grobs(gt).raw_ptr(),
+		                        	uint (sizeof(index_t) * mesh->grobs(gt).num_indices()));
+					fill += uint (sizeof(index_t) * mesh->grobs(gt).num_indices());
+					break;
+
+				case QUAD: {
+					const index_t numQuads = mesh->grobs(gt).size();
+					const index_t numQuadInds = mesh->grobs(gt).num_indices();
+					std::vector <index_t> tris;
+					tris.reserve (numQuads * 6);
+
+					const index_t* quads = mesh->grobs(gt).raw_ptr();
+					for(index_t i = 0; i < numQuadInds; i += 4) {
+						tris.push_back (quads[i]);
+						tris.push_back (quads[i + 1]);
+						tris.push_back (quads[i + 2]);
+
+						tris.push_back (quads[i + 3]);
+						tris.push_back (quads[i]);
+						tris.push_back (quads[i + 2]);
+					}
+
+					curStage.indBuf->set_sub_data (
+					                fill,
+					                &tris.front(),
+		                        	uint (sizeof(index_t) * tris.size()));
+					fill += uint (sizeof(index_t) * tris.size());
+				}	break;
 			}
 		}
+	}
 
-		//	coordinates
-		if (curStage.coordBuf){
-			curStage.coordBuf->bind ();
-			glVertexAttribPointer (0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-			glEnableVertexAttribArray (0);
-		}
-		else {
-			curStage.bndSphere = SphereFromCoords (UNPACK_DST(*mesh->coords()));
-			curStage.coordBuf = std::make_shared <GLBuffer> (GL_ARRAY_BUFFER);
-			curStage.coordBuf->set_data (mesh->coords()->raw_ptr(),
-			                           sizeof(real_t) * mesh->num_coords());
-			glVertexAttribPointer (0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-			glEnableVertexAttribArray (0);
-		}
+	if (!curStage.subsetAnnexName.empty())
+		prepare_primitive_subsets (curStage);
 
-		//	normals
-		if (curStage.normBuf){
-			curStage.normBuf->bind ();
-			glVertexAttribPointer (1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-			glEnableVertexAttribArray (1);
-		}
-		else if (curMeshNeedsVrtNormals){
-			curStage.normBuf = std::make_shared <GLBuffer> (GL_ARRAY_BUFFER);
-			curStage.normBuf->set_data (mesh->annex<RealArrayAnnex>("normals", VERTEX)->raw_ptr(),
-			                            sizeof(real_t) * mesh->annex<RealArrayAnnex>("normals", VERTEX)->size());
-			glVertexAttribPointer (1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-			glEnableVertexAttribArray (1);
-		}
-		else
-			glDisableVertexAttribArray (1);
-
-		//	indices
-		if (curStage.indBuf)
-			curStage.indBuf->bind ();
-		else {
-			curStage.indBuf = std::make_shared <GLBuffer> (GL_ELEMENT_ARRAY_BUFFER);
-
-			curStage.indBuf->set_size (uint (curStage.numInds * sizeof (index_t)));
-			const GrobSet gs = curStage.grobSet;
-			
-			uint fill = 0;
-			for(auto gt : gs) {
-				if (mesh->grobs(gt).empty())
-					continue;
-
-				switch (gt) {
-					case EDGE:
-					case TRI:
-						curStage.indBuf->set_sub_data (
-						                fill,
-						                mesh->grobs(gt).raw_ptr(),
-			                        	uint (sizeof(index_t) * mesh->grobs(gt).num_indices()));
-						fill += uint (sizeof(index_t) * mesh->grobs(gt).num_indices());
-						break;
-
-					case QUAD: {
-						const index_t numQuads = mesh->grobs(gt).size();
-						const index_t numQuadInds = mesh->grobs(gt).num_indices();
-						std::vector <index_t> tris;
-						tris.reserve (numQuads * 6);
-
-						const index_t* quads = mesh->grobs(gt).raw_ptr();
-						for(index_t i = 0; i < numQuadInds; i += 4) {
-							tris.push_back (quads[i]);
-							tris.push_back (quads[i + 1]);
-							tris.push_back (quads[i + 2]);
-
-							tris.push_back (quads[i + 3]);
-							tris.push_back (quads[i]);
-							tris.push_back (quads[i + 2]);
-						}
-
-						curStage.indBuf->set_sub_data (
-						                fill,
-						                &tris.front(),
-			                        	uint (sizeof(index_t) * tris.size()));
-						fill += uint (sizeof(index_t) * tris.size());
-					}	break;
-				}
+	curStage.dirty = false;
+}
+
+void Renderer::
+prepare_primitive_subsets (Stage& stage)
+{
+	if (stage.primSubsets)
+		return;
+
+//	the subset indices are associated with the mesh. The variant has to differ
+//	from the variants used for the index buffers of the mesh.
+	const int variant = - 1 - int (stage.grobSet.type());
+	SPMesh mesh = stage.mesh;
+
+	stage.primSubsets = std::make_shared <GLBufferTexture> ();
+	auto buf = GLResourceCache::find_buffer (mesh, variant);
+	if (!buf) {
+	//	one entry per rendered triangle in the order of the index buffer
+		std::vector <uint32_t> primSubsets;
+		primSubsets.reserve (stage.numInds / 3);
+
+		for(auto gt : stage.grobSet) {
+			if (mesh->grobs (gt).empty())
+				continue;
+
+			const IndexArrayAnnex& subsets =
+				*mesh->annex <IndexArrayAnnex> (stage.subsetAnnexName, gt);
+
+			const index_t numTrisPerGrob = (gt == QUAD) ? 2 : 1;
+			for(index_t i = 0; i < subsets.size(); ++i) {
+				for(index_t j = 0; j < numTrisPerGrob; ++j)
+					primSubsets.push_back (uint32_t (subsets [i]));
 			}
 		}
+
+		const uint size = uint (sizeof (uint32_t) * primSubsets.size());
+		buf = GLResourceCache::create_buffer (mesh, variant, GL_TEXTURE_BUFFER, size);
+		if (size > 0)
+			buf->set_data (primSubsets.data(), size);
+		else
+			buf->set_size (0);
+	}
+
+	stage.primSubsets->set_buffer (buf, GL_R32UI);
+}
+
+///	transfers the given data to the buffer of tex. tex is created if necessary.
+static void
+UploadTable (std::shared_ptr <GLBufferTexture>& tex,
+             const void* data,
+             const uint size,
+             const GLenum internalFormat)
+{
+	if (!tex) {
+		tex = std::make_shared <GLBufferTexture> ();
+		tex->set_buffer (std::make_shared <GLBuffer> (GL_TEXTURE_BUFFER, GL_DYNAMIC_DRAW),
+		                 internalFormat);
 	}
+
+	auto buf = tex->buffer();
+	const uint oldCapacity = buf->capacity();
+	buf->set_data (data, size);
+
+//	the texture has to be attached again if a new data store was allocated
+	if (buf->capacity() != oldCapacity)
+		tex->set_buffer (buf, internalFormat);
+}
+
+void Renderer::
+prepare_subset_table ()
+{
+	if (!m_subsetTableDirty)
+		return;
+
+//	avoid an empty buffer store, which may not be attached to a texture
+	if (m_subsetColors.empty())
+		m_subsetColors.push_back (glm::vec4 (1.f));
+	m_subsetVisibilities.resize (m_subsetColors.size(), 1);
+
+	UploadTable (m_subsetColorTex,
+	             m_subsetColors.data(),
+	             uint (sizeof (glm::vec4) * m_subsetColors.size()),
+	             GL_RGBA32F);
+
+	UploadTable (m_subsetVisibilityTex,
+	             m_subsetVisibilities.data(),
+	             uint (sizeof (uint8_t) * m_subsetVisibilities.size()),
+	             GL_R8UI);
+
+	m_subsetTableDirty = false;
 }
 
 void Renderer::
 render (const View& view)
 {
 	prepare_buffers ();
+	prepare_subset_table ();
 
 	glEnable (GL_BLEND);
 	glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glDepthFunc(GL_LEQUAL);
 
 	for(auto& stage : m_stages) {
-		Shader shader = get_shader (stage.grobSet, stage.shadingPreset);
+		const bool bySubset = bool (stage.primSubsets) && bool (m_subsetColorTex);
+		Shader shader = get_shader (stage.grobSet, stage.shadingPreset, bySubset);
 		view.apply ();
 		shader.use ();
 		shader.set_view (view);
 		shader.set_uniform("color", stage.color);
+		if (bySubset) {
+			stage.primSubsets->bind (0);
+			m_subsetColorTex->bind (1);
+			m_subsetVisibilityTex->bind (2);
+			shader.set_uniform("primitiveSubsets", 0);
+			shader.set_uniform("subsetColors", 1);
+			shader.set_uniform("subsetVisibilities", 2);
+			shader.set_uniform("flatShading", stage.shadingPreset == FLAT ? 1 : 0);
+		}
 		shader.set_uniform("zfacNear", stage.zfacNear);
 		shader.set_uniform("zfacFar", stage.zfacFar);
 		glBindVertexArray (stage.vao);
@@ -294,11 +524,45 @@ render (const View& view)
 
 
 Shader Renderer::
-get_shader (const GrobSet grobSet, ShadingPreset shading)
+get_shader (const GrobSet grobSet, ShadingPreset shading, bool bySubset)
 {
 	COND_THROW (grobSet.size() == 0, "Invalid grob set specified: " << grobSet.name());
 
 	const grob_t grobType = grobSet.grob_type (0);
+
+	if (bySubset) {
+	//	the subset shaders support all shading presets. For triangles, flat
+	//	shading is toggled through the 'flatShading' uniform.
+		Shader& s = m_subsetShaders [grobType] [shading];
+		if (s)
+			return s;
+
+		switch (grobType) {
+			case TRI:
+				if (shading == SMOOTH)
+					s.add_source_vs (m_shaderPath + "smooth-shading.vs");
+				else
+					s.add_source_vs (m_shaderPath + "no-shading.vs");
+				s.add_source_gs (m_shaderPath + "subset-tri-shading.gs");
+				break;
+
+			case EDGE:
+				if (shading == NONE)
+					s.add_source_vs (m_shaderPath + "no-shading.vs");
+				else
+					s.add_source_vs (m_shaderPath + "smooth-shading.vs");
+				s.add_source_gs (m_shaderPath + "subset-edge-shading.gs");
+				break;
+
+			default:
+				THROW ("Coloring by subset not supported for grob type " << GrobName(grobType));
+		}
+
+		s.add_source_fs (m_shaderPath + "subset-shading.fs");
+		s.link();
+		return s;
+	}
+
 	Shader& s = m_shaders [grobType] [shading];
 	if (s)
 		return s;
@@ -364,7 +628,13 @@ void Renderer::do_imgui (bool* pOpened)
 
 	    	int index = stage.shadingPreset;
 	    	ImGui::Combo ("shading", &index, shadingNames, IM_ARRAYSIZE(shadingNames));
-	    	stage.shadingPreset = ShadingPreset(index);
+	    	if (index != stage.shadingPreset) {
+	    	//	a different shading preset may require additional vertex attributes
+	    		stage.shadingPreset = ShadingPreset(index);
+	    		stage.dirty = true;
+	    		stage.normBuf.reset ();
+	    		m_buffersDirty = true;
+	    	}
 
 	        ImGui::TreePop();
 	    }
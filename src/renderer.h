@@ -27,11 +27,14 @@
 #ifndef __H__Renderer
 #define __H__Renderer
 
+#include <cstdint>
 #include <map>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include "gl_buffer.h"
+#include "gl_resource_cache.h"
 #include "lume/mesh.h"
 #include "shader.h"
 #include "vec_math.h"
@@ -69,6 +72,49 @@ public:
 	/** stageInd may be negative. In that case, -1 is the last, -2 the second to last, etc.*/
 	void stage_set_color (const glm::vec4& color, int stageInd = -1);
 
+	///	colors the primitives of the specified stage by their subset.
+	/** For each grob type in the grob set of the stage, the mesh of the stage
+	 * has to provide an `IndexArrayAnnex` with the given name, which holds the
+	 * subset index of each grob. Color and visibility of each subset are taken
+	 * from the subset table of the renderer (see `set_subset_colors` and
+	 * `set_subset_visible`). Face stages take their color from the subset table,
+	 * edge stages keep their stage color. Regardless of the number of subsets,
+	 * all primitives of the stage are drawn with a single draw call.
+	 * stageInd may be negative (see `stage_set_color`).*/
+	void stage_set_subset_annex (const std::string& annexName, int stageInd = -1);
+
+	///	sets the colors of all subsets for stages which are colored by subset
+	/** Subsets are visible by default (see `set_subset_visible`).*/
+	void set_subset_colors (std::vector <glm::vec4> colors);
+
+	///	changes the color of a single subset
+	/** Only the color of the given subset is transferred to the GPU.*/
+	void set_subset_color (const index_t si, const glm::vec4& color);
+
+	///	shows or hides all primitives of the given subset in stages which are colored by subset
+	/** Only the visibility of the given subset is transferred to the GPU. No
+	 * buffers of the stages have to be rebuilt.*/
+	void set_subset_visible (const index_t si, const bool visible);
+
+	///	marks the buffers of the specified stage as outdated. They are rebuilt before the next draw.
+	/** Call this method if the grobs or annexes of the mesh of a stage were
+	 * changed in-place. stageInd may be negative (see `stage_set_color`).*/
+	void invalidate_stage (int stageInd = -1);
+
+	///	marks the index buffer of the specified stage as outdated.
+	/** Call this method if the grobs of the mesh of a stage were changed in-place
+	 * while their number and their subsets stayed the same. Other buffers of
+	 * the stage are kept. stageInd may be negative (see `stage_set_color`).*/
+	void invalidate_stage_grobs (int stageInd = -1);
+
+	///	marks the vertex normal buffer of the specified stage as outdated.
+	/** Call this method if the vertex normals of the mesh of a stage were
+	 * changed in-place. stageInd may be negative (see `stage_set_color`).*/
+	void invalidate_stage_normals (int stageInd = -1);
+
+	///	marks the buffers of all stages as outdated.
+	void invalidate ();
+
 	///	returns min (x) and max (y) z clip distances required to show all polygons.
 	glm::vec2 estimate_z_clip_dists (const View& view) const;
 
@@ -78,7 +124,7 @@ public:
 
 private:
 	struct Stage {
-		Stage ()	{glGenVertexArrays (1, &vao);}
+		Stage () : vao (GLResourceCache::acquire_vao ()), numInds (0), dirty (true)	{}
 		Stage (const Stage&) = delete;
 		Stage (Stage&& s) :
 			name (std::move (s.name)),
@@ -94,10 +140,13 @@ private:
 			primType (std::move (s.primType)),
 			numInds (std::move (s.numInds)),
 			grobSet (std::move (s.grobSet)),
-			bndSphere (std::move (s.bndSphere))
+			bndSphere (std::move (s.bndSphere)),
+			subsetAnnexName (std::move (s.subsetAnnexName)),
+			primSubsets (std::move (s.primSubsets)),
+			dirty (std::move (s.dirty))
 		{}
 
-		~Stage ()	{if (vao) glDeleteVertexArrays (1, &vao);}
+		~Stage ()	{GLResourceCache::release_vao (vao);}
 
 		std::string 				name;
 		lume::SPMesh				mesh;
@@ -114,18 +163,32 @@ private:
 		GLsizei						numInds;
 		lume::GrobSet				grobSet;
 		Sphere						bndSphere;
+		std::string					subsetAnnexName;
+		std::shared_ptr <GLBufferTexture>	primSubsets;
+		bool						dirty;
 	};
 
 	
 	Stage& stage (int stageInd);
 	const Stage& stage (int stageInd) const;
-	Shader get_shader (const lume::GrobSet grobSet, ShadingPreset shading);
+	Shader get_shader (const lume::GrobSet grobSet, ShadingPreset shading, bool bySubset);
 	void prepare_buffers ();
+	void prepare_stage (const size_t istage);
+	void prepare_primitive_subsets (Stage& stage);
+	void prepare_subset_table ();
 
 
 	std::vector <Stage> m_stages;
+	bool				m_buffersDirty;
 	Shader				m_shaders[lume::NUM_GROB_TYPES + 1][NUM_SHADING_PRESETS];
+	Shader				m_subsetShaders[lume::NUM_GROB_TYPES + 1][NUM_SHADING_PRESETS];
 	std::string			m_shaderPath;
+
+	std::vector <glm::vec4>				m_subsetColors;
+	std::vector <uint8_t>				m_subsetVisibilities;
+	std::shared_ptr <GLBufferTexture>	m_subsetColorTex;
+	std::shared_ptr <GLBufferTexture>	m_subsetVisibilityTex;
+	bool								m_subsetTableDirty;
 };
 
 }// end of namespace lumeview
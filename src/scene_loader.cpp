@@ -0,0 +1,155 @@
+// This file is part of lumeview, a lightweight viewer for unstructured meshes
+//
+// Copyright (C) 2018 Sebastian Reiter
+// Copyright (C) 2018 G-CSC, Goethe University Frankfurt
+// Author: Sebastian Reiter <s.b.reiter@gmail.com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+
+#include "scene_loader.h"
+#include "message_queue.h"
+#include "scene_util.h"
+#include "lume/thread_pool.h"
+
+using namespace std;
+
+namespace lumeview {
+
+SceneLoader::
+SceneLoader (std::string filename, const bool useCache, lume::LoadProgressCallback progress) :
+	m_filename (std::move (filename)),
+	m_useCache (useCache),
+	m_progressCallback (std::move (progress)),
+	m_cancelRequested (false),
+	m_state (LOADING)
+{
+	m_thread = thread (&SceneLoader::load, this);
+}
+
+SceneLoader::
+~SceneLoader ()
+{
+	cancel ();
+	m_thread.join ();
+}
+
+SceneLoader::State SceneLoader::
+state () const
+{
+	lock_guard <mutex> lock (m_mutex);
+	return m_state;
+}
+
+SceneLoadProgress SceneLoader::
+progress () const
+{
+	lock_guard <mutex> lock (m_mutex);
+	return m_progress;
+}
+
+void SceneLoader::
+cancel ()
+{
+	m_cancelRequested = true;
+}
+
+SPScene SceneLoader::
+scene ()
+{
+	lock_guard <mutex> lock (m_mutex);
+	if (m_state != FINISHED)
+		return SPScene ();
+
+//	the scene is complete, so that its receivers may now receive messages
+	if (!m_receivers.empty ()) {
+		MessageQueue::add_receivers (m_receivers);
+		m_receivers.clear ();
+	}
+	return m_scene;
+}
+
+std::string SceneLoader::
+error_message () const
+{
+	lock_guard <mutex> lock (m_mutex);
+	return m_errorMessage;
+}
+
+bool SceneLoader::
+set_progress (const char* phase, const uint64_t bytesDone, const uint64_t bytesTotal)
+{
+	{
+		lock_guard <mutex> lock (m_mutex);
+		m_progress.phase = phase;
+		m_progress.bytesDone = bytesDone;
+		m_progress.bytesTotal = bytesTotal;
+	}
+
+	if (m_progressCallback && !m_progressCallback (phase, bytesDone, bytesTotal))
+		m_cancelRequested = true;
+
+	return !m_cancelRequested;
+}
+
+void SceneLoader::
+load ()
+{
+//	receivers of the scene must not receive messages on the main thread while
+//	they are still being constructed on this thread
+	vector <MessageReceiver*> receivers;
+	MessageQueue::begin_deferred_registration (receivers);
+
+//	parallel work of the loader runs on a pool of its own. Otherwise the
+//	rendering thread, which waits for tasks of the global pool (e.g. while
+//	subset visibilities change), would queue behind the tasks of the loader.
+	lume::ThreadPool pool (lume::ThreadPool::default_num_threads ());
+	lume::ThreadPool::CurrentScope poolScope (pool);
+
+	SPScene scene;
+	State state = FINISHED;
+	string errorMessage;
+	try {
+		scene = CreateSceneForMesh (m_filename, m_useCache,
+			[this] (const char* phase, uint64_t bytesDone, uint64_t bytesTotal)
+			{return set_progress (phase, bytesDone, bytesTotal);});
+
+		if (m_cancelRequested) {
+			scene.reset ();
+			state = CANCELLED;
+		}
+	}
+	catch (lume::LoadCancelledError&) {
+		state = CANCELLED;
+	}
+	catch (std::exception& e) {
+		state = FAILED;
+		errorMessage = e.what ();
+	}
+
+	MessageQueue::end_deferred_registration ();
+
+	lock_guard <mutex> lock (m_mutex);
+	m_scene = std::move (scene);
+	m_receivers = std::move (receivers);
+	m_errorMessage = std::move (errorMessage);
+	m_state = state;
+}
+
+}//	end of namespace lumeview
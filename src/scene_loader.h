@@ -0,0 +1,136 @@
+// This file is part of lumeview, a lightweight viewer for unstructured meshes
+//
+// Copyright (C) 2018 Sebastian Reiter
+// Copyright (C) 2018 G-CSC, Goethe University Frankfurt
+// Author: Sebastian Reiter <s.b.reiter@gmail.com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+
+#ifndef __H__lumeview_scene_loader
+#define __H__lumeview_scene_loader
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "lume/file_io.h"
+#include "scene.h"
+
+namespace lumeview {
+
+class MessageReceiver;
+
+/// progress of a `SceneLoader`
+struct SceneLoadProgress {
+	SceneLoadProgress () : bytesDone (0), bytesTotal (0)	{}
+
+	std::string	phase;		///< description of the current phase, e.g. "parsing"
+	uint64_t	bytesDone;	///< bytes processed in the current phase
+	uint64_t	bytesTotal;	///< bytes to process in the current phase or 0 if unknown
+};
+
+/// Loads a scene from a mesh file on a background thread
+/** The mesh and its visualization are created on a thread of their own (see
+ * `CreateSceneForMesh`), so that the application stays responsive while large
+ * files are loaded. Parallel work of that thread runs on a separate
+ * `lume::ThreadPool`, so that it doesn't delay parallel work of other threads.
+ * The progress can be queried at any time and loading can be cancelled.
+ *
+ * Message receivers which are created during loading (e.g. visualizations)
+ * are registered with the `MessageQueue` once the scene is retrieved through
+ * `scene`. Apart from the optional progress callback, all methods thus have to
+ * be called from the thread which dispatches messages.*/
+class SceneLoader {
+public:
+	enum State {
+		LOADING,
+		FINISHED,
+		FAILED,
+		CANCELLED
+	};
+
+	/// Starts loading the given file
+	/** \param useCache	see `CreateSceneForMesh`
+	 *  \param progress	(optional) is called on the loading thread whenever the
+	 *					progress changes. Returning false cancels loading.*/
+	SceneLoader (std::string filename,
+	             const bool useCache = false,
+	             lume::LoadProgressCallback progress = lume::LoadProgressCallback ());
+
+	/// cancels loading and waits until the loading thread has finished
+	/** The loading thread stops at its next progress report. Reports are
+	 * frequent while numbers are parsed, but steps which don't report progress
+	 * (e.g. locating the xml nodes of a ugx file or building neighborhoods)
+	 * run to completion first. Destroying a loader may thus block the calling
+	 * thread for the duration of such a step. Call `cancel` on all loaders
+	 * before destroying any of them, so that they stop concurrently, and only
+	 * destroy loaders whose `state` isn't `LOADING` while the application
+	 * has to stay responsive.*/
+	~SceneLoader ();
+
+	SceneLoader (const SceneLoader&) = delete;
+	SceneLoader& operator = (const SceneLoader&) = delete;
+
+	const std::string& filename () const	{return m_filename;}
+
+	State state () const;
+
+	SceneLoadProgress progress () const;
+
+	/// requests cancellation. The state changes to `CANCELLED` once the loading thread stopped.
+	/** Loading is interrupted at the next progress report. A scene which was
+	 * already loaded is discarded.*/
+	void cancel ();
+
+	bool cancel_requested () const	{return m_cancelRequested;}
+
+	/// returns the loaded scene if the state is `FINISHED` and an empty pointer otherwise
+	SPScene scene ();
+
+	/// describes the error which occurred if the state is `FAILED`
+	std::string error_message () const;
+
+private:
+	void load ();
+	bool set_progress (const char* phase, const uint64_t bytesDone, const uint64_t bytesTotal);
+
+	const std::string					m_filename;
+	const bool							m_useCache;
+	const lume::LoadProgressCallback	m_progressCallback;
+	std::atomic <bool>					m_cancelRequested;
+
+	mutable std::mutex					m_mutex;
+	State								m_state;
+	SceneLoadProgress					m_progress;
+	std::string							m_errorMessage;
+	SPScene								m_scene;
+	std::vector <MessageReceiver*>		m_receivers;
+
+	std::thread							m_thread;
+};
+
+using SPSceneLoader = std::shared_ptr <SceneLoader>;
+
+}//	end of namespace lumeview
+
+#endif	//__H__lumeview_scene_loader
@@ -40,10 +40,27 @@ SPScene CreateSceneForMesh (const lume::SPMesh& mesh)
 	}
 }
 
-SPScene CreateSceneForMesh (const std::string& filename)
+SPScene CreateSceneForMesh (const std::string& filename,
+                            const bool useCache,
+                            const lume::LoadProgressCallback& progress)
 {
-	auto mesh = lume::CreateMeshFromFile (filename);
-	return CreateSceneForMesh (mesh);
+	auto mesh = lume::CreateMeshFromFile (filename, useCache, progress);
+	ReportVisualizationProgress (progress, "preparing visualization");
+
+	const std::string cacheFilename = useCache ? filename + VISUALIZATION_CACHE_SUFFIX : std::string ();
+	try {
+		auto scene = std::make_shared <Scene> ();
+		scene->add_entry (mesh, std::make_shared <SubsetVisualization> (mesh, cacheFilename, progress));
+		return scene;
+	}
+	catch (lume::LoadCancelledError&) {
+		throw;
+	}
+	catch (...) {
+		auto scene = std::make_shared <Scene> ();
+		scene->add_entry (mesh, std::make_shared <PlainVisualization> (mesh, cacheFilename, progress));
+		return scene;
+	}
 }
 
 
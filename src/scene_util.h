@@ -28,6 +28,7 @@
 #define __H__lumeview_scene_util
 
 #include "scene.h"
+#include "visualization_cache.h"
 #include "lume/file_io.h"
 #include "lume/mesh.h"
 
@@ -46,15 +47,34 @@ SPScene CreateSceneForMesh (const lume::SPMesh& mesh)
 SPScene CreateSceneForMesh (const lume::SPMesh& mesh);
 
 /// Creates a scene and adds the given mesh from file with the specified visualization
+/** \param useCache	If true, the mesh and the data derived by the visualization
+ *					are cached in files next to `filename` and are loaded
+ *					from there if they are up to date.*/
 template <class TVisualization>
-SPScene CreateSceneForMesh (const std::string& filename)
+SPScene CreateSceneForMesh (const std::string& filename, const bool useCache = false)
 {
-	auto mesh = lume::CreateMeshFromFile (filename);
-	return CreateSceneForMesh <TVisualization> (mesh);
+	auto mesh = lume::CreateMeshFromFile (filename, useCache);
+	auto scene = std::make_shared <Scene> ();
+	scene->add_entry (mesh, std::make_shared <TVisualization> (
+	                            mesh, useCache ? filename + VISUALIZATION_CACHE_SUFFIX : std::string ()));
+	return scene;
 }
 
 /// Creates a scene and adds the given mesh from file with the best matching visualization
-SPScene CreateSceneForMesh (const std::string& filename);
+/** \param useCache	If true, the mesh and the data derived by the visualization
+ *					are cached in files next to `filename` and are loaded
+ *					from there if they are up to date.
+ *
+ * \param progress	(optional) receives the progress of loading the mesh (see
+ *					`lume::CreateMeshFromFile`), followed by the phases of
+ *					the creation of the visualization. Returning false
+ *					cancels loading through a `lume::LoadCancelledError`.
+ *
+ * No OpenGL calls are performed, so that scenes may be created on a worker
+ * thread (see `SceneLoader`).*/
+SPScene CreateSceneForMesh (const std::string& filename,
+                            const bool useCache = false,
+                            const lume::LoadProgressCallback& progress = lume::LoadProgressCallback ());
 
 ///	Creates a scene with a predefined mesh and visualization. Useful mainly for debugging and testing.
 SPScene CreateSampleScene ();
@@ -152,6 +152,11 @@ public:
     	glUniform1f(glGetUniformLocation(data().m_shaderProg, name), v);
 	}
 
+	void set_uniform (const char* name, const int v) const
+	{
+    	glUniform1i(glGetUniformLocation(data().m_shaderProg, name), v);
+	}
+
 	void set_uniform (const char* name, const glm::vec4& v) const
 	{
     	glUniform4fv(glGetUniformLocation(data().m_shaderProg, name),
@@ -29,6 +29,7 @@
 #include <glm/gtc/type_ptr.hpp>
 #include "lumeview_error.h"
 #include "shapes.h"
+#include "lume/parallel_algorithms.h"
 #include "lume/vec_math_raw.h"
 
 using namespace std;
@@ -93,16 +94,28 @@ template <class real_t>
 TBox <real_t> BoxFromCoords (const real_t* coords, index_t num, index_t stride)
 {
 	const index_t cmps = std::min<index_t> (stride, 3);
-
-	TBox <real_t> b (numeric_limits<real_t>::max(), numeric_limits<real_t>::lowest());
-	for(index_t i = 0; i < num; i+=stride){
-		for(index_t j = 0; j < cmps; ++j){
-			if (coords [i+j] < b.minCorner[j])
-				b.minCorner[j] = coords [i+j];
-			if (coords [i+j] > b.maxCorner[j])
-				b.maxCorner[j] = coords [i+j];
-		}
-	}
+	const index_t numCoords = stride ? num / stride : 0;
+
+	TBox <real_t> b = parallel_reduce (
+		index_t (0), numCoords,
+		TBox <real_t> (numeric_limits<real_t>::max(), numeric_limits<real_t>::lowest()),
+		[coords, stride, cmps] (TBox <real_t> b, const index_t ic) {
+			const real_t* c = coords + ic * stride;
+			for(index_t j = 0; j < cmps; ++j){
+				if (c [j] < b.minCorner[j])
+					b.minCorner[j] = c [j];
+				if (c [j] > b.maxCorner[j])
+					b.maxCorner[j] = c [j];
+			}
+			return b;
+		},
+		[cmps] (TBox <real_t> a, const TBox <real_t>& b) {
+			for(index_t j = 0; j < cmps; ++j){
+				a.minCorner[j] = std::min (a.minCorner[j], b.minCorner[j]);
+				a.maxCorner[j] = std::max (a.maxCorner[j], b.maxCorner[j]);
+			}
+			return a;
+		});
 
 	for(index_t i = stride; i < 3; ++i){
 		b.minCorner[i] = 0;
@@ -178,12 +191,12 @@ TSphere <real_t> SphereFromCoords (const real_t* coords, index_t num, index_t st
 //	find the coordinate with the largest index
 	const index_t cmps = std::min<index_t> (stride, 3);
 
-	real_t maxRadSq = 0;
-	for(index_t i = 0; i < num; i+=stride) {
-		const real_t d = VecDistSq (pcenter, stride, coords + i);
-		if (d > maxRadSq)
-			maxRadSq = d;
-	}
+	const real_t maxRadSq = parallel_reduce (
+		index_t (0), num / stride, real_t (0),
+		[pcenter, coords, stride] (const real_t maxD, const index_t ic) {
+			return std::max (maxD, VecDistSq (pcenter, stride, coords + ic * stride));
+		},
+		[] (const real_t a, const real_t b) {return std::max (a, b);});
 
 	return TSphere <real_t> (center, sqrt(maxRadSq));
 }
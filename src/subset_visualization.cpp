@@ -25,47 +25,219 @@
 // THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <algorithm>
+#include <cstdint>
+#include <limits>
 #include "subset_visualization.h"
+#include "gl_resource_cache.h"
 #include "lume/annex_table.h"
+#include "lume/binary_mesh_file.h"
+#include "lume/neighborhoods.h"
 #include "lume/normals.h"
-#include "lume/rim_mesh.h"
+#include "lume/parallel_algorithms.h"
 #include "lume/subset_info_annex.h"
 #include "lume/topology.h"
+#include "lume/vec_math_raw.h"
 #include "subset_info_annex_message.h"
+#include "visualization_cache.h"
 
 using namespace std;
 using namespace lume;
 
 namespace lumeview {
 
+static const index_t NO_RIM_SUBSET = numeric_limits <index_t>::max ();
+
+//	name of the annex of the face pool which holds the adjacent subsets of each
+//	face. Unused entries of a tuple hold NO_RIM_SUBSET.
+static const char* ADJACENT_SUBSETS = "adjacentSubsets";
+
+//	name of the annex of the face pool which holds the indices of the edges of
+//	each face in the pool
+static const char* FACE_EDGES = "faceEdges";
+
+//	name of the NO_GROB annex of a cached batch mesh which holds the number of subsets
+static const char* NUM_SUBSETS = "numSubsets";
+
+//	name of the NO_GROB annex of a cached batch mesh which holds the ranges of
+//	all subsets. For each type in BATCH_GROB_TYPES, the offsets of all
+//	subsets are followed by their sizes (see `SubsetVisualization::BatchRanges`).
+static const char* BATCH_RANGES = "batchRanges";
+
+//	identifies the layout of cached batch meshes. Change it whenever the way in
+//	which batch meshes are created changes.
+static const char* BATCH_MESH_CACHE_TAG = "SubsetVisualization/batchMesh/2";
+
+//	identifies the layout of cached face pools. Change it whenever the way in
+//	which face pools are created changes.
+static const char* FACE_POOL_CACHE_TAG = "SubsetVisualization/facePool/1";
+
+//	suffix which is appended to the cache filename to obtain the name of the
+//	file in which the face pool of a volume mesh is cached
+static const char* FACE_POOL_CACHE_SUFFIX = ".rim";
+
+//	indices of the stages of the renderer (see `SubsetVisualization::prepare_renderer`)
+static const int SOLID_STAGE = 0;
+static const int WIRE_STAGE = 1;
+
+//	grob types of the batch mesh
+static const grob_t BATCH_GROB_TYPES[] = {EDGE, TRI, QUAD};
+
+//	number of blocks per thread into which grobs are divided by counting sorts
+static const index_t NUM_BLOCKS_PER_THREAD = 4;
+
+/// corners of the grobs of one subset of the batch mesh, for each grob type
+struct SubsetVisualization::SubsetGrobs {
+	index_t num (const grob_t gt) const
+	{
+		return index_t (corners [gt].size() / GrobDesc (gt).num_corners ());
+	}
+
+	vector <index_t>	corners [NUM_GROB_TYPES];
+};
+
+/// provides the tuples of an annex of the faces of a face pool (see `SubsetVisualization::m_facePool`)
+/** Faces are addressed by their index in the pool, where all triangles precede all quadrilaterals.*/
+class PoolFaceTuples {
+public:
+	PoolFaceTuples (const Mesh& facePool, const char* annexName) :
+		m_numTris (facePool.num (TRI))
+	{
+		for(auto gt : GrobSet (FACES)) {
+			m_tuples [gt] = nullptr;
+			m_tupleSizes [gt] = 0;
+			if (auto a = facePool.optional_annex <IndexArrayAnnex> (annexName, gt)) {
+				m_tuples [gt] = a->raw_ptr ();
+				m_tupleSizes [gt] = a->tuple_size ();
+			}
+		}
+	}
+
+	index_t tuple_size (const index_t fi) const
+	{
+		return fi < m_numTris ? m_tupleSizes [TRI] : m_tupleSizes [QUAD];
+	}
+
+	const index_t* operator [] (const index_t fi) const
+	{
+		if (fi < m_numTris)
+			return m_tuples [TRI] + fi * m_tupleSizes [TRI];
+		return m_tuples [QUAD] + (fi - m_numTris) * m_tupleSizes [QUAD];
+	}
+
+private:
+	const index_t*	m_tuples [NUM_GROB_TYPES];
+	index_t			m_tupleSizes [NUM_GROB_TYPES];
+	index_t			m_numTris;
+};
+
+/// calls `callback (si)` for each subset which occurs exactly once in the given tuple
+template <class TCallback>
+static void ForEachSingleSubset (const index_t* subsets, const index_t tupleSize, const TCallback& callback)
+{
+	for(index_t i = 0; i < tupleSize; ++i) {
+		const index_t si = subsets [i];
+		if (si == NO_RIM_SUBSET)
+			continue;
+
+		bool single = true;
+		for(index_t j = 0; j < tupleSize; ++j) {
+			if (j != i && subsets [j] == si) {
+				single = false;
+				break;
+			}
+		}
+		if (single)
+			callback (si);
+	}
+}
+
+/// adds `sign` times the normal of each given face to the normal sums of its corners
+static void AccumulateFaceNormals (vector <real_t>& normalSums,
+                                   const real_t* coords,
+                                   const index_t* corners,
+                                   const index_t numFaces,
+                                   const index_t numCorners,
+                                   const real_t sign)
+{
+	for(index_t i = 0; i < numFaces; ++i) {
+		const index_t* face = corners + i * numCorners;
+		real_t n[3];
+		FaceNormal3 (n, coords, face, numCorners);
+		for(index_t j = 0; j < numCorners; ++j) {
+			real_t* sum = normalSums.data() + face [j] * 3;
+			for(index_t k = 0; k < 3; ++k)
+				sum [k] += sign * n [k];
+		}
+	}
+}
+
+/// calls `func (si)` concurrently for each subset index in `subsets`
+/** Each subset is processed by a task of its own. Since a few subsets usually
+ * hold most faces, subsets with a large `size (si)` are scheduled first.*/
+template <class TSize, class TFunc>
+static void ParallelForEachSubset (vector <index_t> subsets,
+                                   const TSize& size,
+                                   const TFunc& func)
+{
+	stable_sort (subsets.begin(), subsets.end(),
+	             [&size] (const index_t si0, const index_t si1) {return size (si0) > size (si1);});
+
+	parallel_for (index_t (0), index_t (subsets.size()),
+	              [&] (const index_t i) {func (subsets [i]);},
+	              1);
+}
+
 SubsetVisualization::SubsetVisualization () :
-	m_refreshRequired (false)
+	m_meshHash (0),
+	m_meshHashValid (false),
+	m_numSubsets (0),
+	m_rendererOutdated (false)
 {
 }
 
-SubsetVisualization::SubsetVisualization (lume::SPMesh mesh) :
-	m_refreshRequired (false)
+SubsetVisualization::SubsetVisualization (lume::SPMesh mesh,
+                                          std::string cacheFilename,
+                                          const lume::LoadProgressCallback& progress) :
+	m_cacheFilename (std::move (cacheFilename)),
+	m_progress (progress),
+	m_meshHash (0),
+	m_meshHashValid (false),
+	m_numSubsets (0),
+	m_rendererOutdated (false)
 {
 	set_mesh (mesh);
+//	the callback may refer to the creator of the visualization, which doesn't
+//	outlive the construction (e.g. `SceneLoader`)
+	m_progress = lume::LoadProgressCallback ();
 }
 
 
 void SubsetVisualization::set_mesh (lume::SPMesh mesh)
 {
 	m_mesh = mesh;
-	GrobSet grobSet = m_mesh->grob_set_type_of_highest_dim ();
-	if (grobSet == CELLS)
-		m_neighborhoods.refresh (mesh, FACES, CELLS);
+	m_facePool.reset ();
+	m_numSubsets = 0;
+	m_candidateOffsets.clear ();
+	m_candidates.clear ();
+	m_faceSubsets.clear ();
+	m_meshHashValid = false;
 	refresh ();
 }
 
 
+void SubsetVisualization::set_cache_filename (std::string cacheFilename)
+{
+	m_cacheFilename = std::move (cacheFilename);
+}
+
 
 void SubsetVisualization::refresh ()
 {
-	m_refreshRequired = false;
+	m_pendingVisibilityChanges.clear ();
 	m_subsetInfo.reset();
-	m_renderer.clear();
+//	stages are created on the rendering thread (see `render`), so that
+//	visualizations may be created on other threads.
+	m_rendererOutdated = true;
 
 	if (!m_mesh)
 		return;
@@ -95,40 +267,650 @@ void SubsetVisualization::refresh ()
 
 	m_subsetInfo = m_mesh->annex<SubsetInfoAnnex> (m_subsetAnnexName, NO_GROB);
 
-	create_subset_meshes (grobSet);
-	prepare_renderer ();
+	const uint64_t cacheKey = m_cacheFilename.empty () ? 0 : batch_mesh_cache_key ();
+
+//	the face pool of a volume mesh is required to update the rim if the
+//	visibility of a subset changes. Its creation requires the neighborhoods
+//	of all faces, so it is cached separately from the batch mesh, independent
+//	of the visible subsets. Surface meshes only need it to create the batch mesh.
+	if (grobSet == CELLS && !m_cacheFilename.empty ()) {
+		const uint64_t poolKey = face_pool_cache_key ();
+		if (!load_cached_face_pool (poolKey)) {
+			create_face_pool (grobSet);
+			ReportVisualizationProgress (m_progress, "writing visualization cache");
+			StoreVisualizationCache (m_cacheFilename + FACE_POOL_CACHE_SUFFIX, poolKey, *m_facePool);
+		}
+	}
+	else if (grobSet == CELLS || !m_facePool)
+		create_face_pool (grobSet);
+	else
+		refresh_face_subsets ();
+
+	if (m_cacheFilename.empty () || !load_cached_batch_mesh (cacheKey)) {
+		ReportVisualizationProgress (m_progress, "creating batch mesh");
+		create_batch_mesh ();
+		if (!m_cacheFilename.empty () && m_batchMesh->has (FACES)) {
+			ReportVisualizationProgress (m_progress, "writing visualization cache");
+			m_batchMesh->annex <IndexArrayAnnex> (NUM_SUBSETS, NO_GROB)->resize (1, m_numSubsets);
+
+			auto& ranges = *m_batchMesh->annex <IndexArrayAnnex> (BATCH_RANGES, NO_GROB);
+			ranges.clear ();
+			for(auto gt : BATCH_GROB_TYPES) {
+				for(auto o : m_batchRanges [gt].offsets)
+					ranges.push_back (o);
+				for(auto size : m_batchRanges [gt].sizes)
+					ranges.push_back (size);
+			}
+
+			StoreVisualizationCache (m_cacheFilename, cacheKey, *m_batchMesh);
+		}
+	}
+}
+
+uint64_t SubsetVisualization::mesh_hash ()
+{
+//	the hash has to be computed before faces are created for the rim of a volume mesh
+	if (!m_meshHashValid) {
+		ReportVisualizationProgress (m_progress, "hashing mesh");
+		m_meshHash = HashMeshContents (*m_mesh);
+		m_meshHashValid = true;
+	}
+	return m_meshHash;
+}
+
+uint64_t SubsetVisualization::face_pool_cache_key ()
+{
+	return VisualizationCacheKey (FACE_POOL_CACHE_TAG, mesh_hash (),
+	                              m_subsetAnnexName.data(), m_subsetAnnexName.size());
+}
+
+bool SubsetVisualization::load_cached_face_pool (const uint64_t cacheKey)
+{
+	ReportVisualizationProgress (m_progress, "reading visualization cache");
+	SPMesh facePool = LoadVisualizationCache (m_cacheFilename + FACE_POOL_CACHE_SUFFIX,
+	                                          cacheKey, m_mesh->coords());
+	if (!facePool)
+		return false;
+
+	for(auto gt : facePool->grob_types ()) {
+		if (gt != EDGE && GrobDesc (gt).dim () != 2)
+			return false;
+	}
+
+//	the annexes of each face have to be consistent with the pool and with the
+//	subsets of the mesh
+	const index_t numEdges = facePool->num (EDGE);
+	const index_t numSubsets = m_subsetInfo->num_subset_properties ();
+	index_t adjacentTupleSize = 0;
+	for(auto gt : GrobSet (FACES)) {
+		if (!facePool->has (gt))
+			continue;
+
+		auto adjacent = facePool->optional_annex <IndexArrayAnnex> (ADJACENT_SUBSETS, gt);
+		auto edges = facePool->optional_annex <IndexArrayAnnex> (FACE_EDGES, gt);
+		if (!adjacent || !edges
+		    || adjacent->tuple_size () == 0
+		    || (adjacentTupleSize != 0 && adjacent->tuple_size () != adjacentTupleSize)
+		    || adjacent->num_tuples () != facePool->num (gt)
+		    || edges->tuple_size () != GrobDesc (gt).num_sides (1)
+		    || edges->num_tuples () != facePool->num (gt))
+		{
+			return false;
+		}
+		adjacentTupleSize = adjacent->tuple_size ();
+
+		const bool validSubsets = parallel_reduce (adjacent->begin(), adjacent->end(), true,
+		                            [numSubsets] (const bool v, const index_t si)
+		                            {return v && (si == NO_RIM_SUBSET || si < numSubsets);},
+		                            [] (const bool a, const bool b) {return a && b;});
+		const bool validEdges = parallel_reduce (edges->begin(), edges->end(), true,
+		                            [numEdges] (const bool v, const index_t ei) {return v && ei < numEdges;},
+		                            [] (const bool a, const bool b) {return a && b;});
+		if (!validSubsets || !validEdges)
+			return false;
+	}
+
+	m_facePool = facePool;
+	prepare_candidates ();
+	refresh_face_subsets ();
+	return true;
+}
+
+uint64_t SubsetVisualization::batch_mesh_cache_key ()
+{
+	mesh_hash ();
+
+//	the rim of a volume mesh depends on the visible subsets. The visibility of
+//	subsets of a surface mesh is applied by the renderer instead.
+	string state = m_subsetAnnexName;
+	state.push_back (0);
+	if (m_mesh->grob_set_type_of_highest_dim () == CELLS) {
+		for(index_t si = 0; si < m_subsetInfo->num_subset_properties (); ++si)
+			state.push_back (subset_visible (si) ? '1' : '0');
+	}
+
+	return VisualizationCacheKey (BATCH_MESH_CACHE_TAG, m_meshHash, state.data(), state.size());
+}
+
+bool SubsetVisualization::load_cached_batch_mesh (const uint64_t cacheKey)
+{
+	ReportVisualizationProgress (m_progress, "reading visualization cache");
+	SPMesh batchMesh = LoadVisualizationCache (m_cacheFilename, cacheKey, m_mesh->coords());
+	if (!batchMesh
+	    || !batchMesh->has_annex (NUM_SUBSETS, NO_GROB)
+	    || !batchMesh->has_annex (BATCH_RANGES, NO_GROB))
+	{
+		return false;
+	}
+
+	const auto& numSubsets = *batchMesh->annex <IndexArrayAnnex> (NUM_SUBSETS, NO_GROB);
+	if (numSubsets.size() != 1 || numSubsets [0] != m_numSubsets)
+		return false;
+
+//	the ranges have to be consistent with the grobs of the batch mesh
+	const index_t n = numSubsets [0];
+	const auto& ranges = *batchMesh->annex <IndexArrayAnnex> (BATCH_RANGES, NO_GROB);
+	if (ranges.size() != 3 * (2 * n + 1))
+		return false;
+
+	BatchRanges batchRanges [NUM_GROB_TYPES];
+	auto iter = ranges.begin();
+	for(auto gt : BATCH_GROB_TYPES) {
+		BatchRanges& r = batchRanges [gt];
+		r.offsets.assign (iter, iter + n + 1);
+		r.sizes.assign (iter + n + 1, iter + 2 * n + 1);
+		iter += 2 * n + 1;
+
+		if (r.offsets.front () != 0 || r.offsets.back () != batchMesh->num (gt))
+			return false;
+		for(index_t si = 0; si < n; ++si) {
+			if (r.offsets [si] > r.offsets [si + 1]
+			    || r.sizes [si] > r.offsets [si + 1] - r.offsets [si])
+			{
+				return false;
+			}
+		}
+	}
+
+	for(auto gt : BATCH_GROB_TYPES)
+		m_batchRanges [gt] = std::move (batchRanges [gt]);
+	m_batchNormalSums.clear ();
+
+	m_batchMesh = batchMesh;
+	return true;
 }
 
-void SubsetVisualization::create_subset_meshes (const GrobSet grobSet)
+void SubsetVisualization::create_face_pool (const GrobSet grobSet)
 {
+	m_facePool = make_shared <Mesh> ();
+	m_facePool->set_coords (m_mesh->coords());
+
 	if (grobSet == CELLS)
-		subset_meshes_from_cell_rim ();
+		create_rim_face_pool ();
 	else
-		subset_meshes_from_grobs (m_mesh, grobSet, false);
+		create_surface_face_pool ();
+
+	create_face_pool_edges ();
+	prepare_candidates ();
+	refresh_face_subsets ();
 }
 
-void SubsetVisualization::prepare_renderer ()
+void SubsetVisualization::create_rim_face_pool ()
 {
-	const glm::vec4 wireColor (0.2f, 0.2f, 0.2f, 1.0f);
+//	faces and their adjacent cells are created in one pass if the mesh
+//	doesn't provide faces. Existing faces are kept, since annexes may refer to them.
+//	The neighborhoods are only required to fill the face pool.
+	ReportVisualizationProgress (m_progress, "creating neighborhoods");
+	Neighborhoods nbrhds;
+	if (m_mesh->has (FACES))
+		nbrhds.refresh (m_mesh, FACES, CELLS);
+	else
+		nbrhds.create_sides_and_refresh (m_mesh, CELLS);
+
+	ReportVisualizationProgress (m_progress, "creating rim");
+	const auto cellSubsets = ArrayAnnexTable <IndexArrayAnnex> (m_mesh, m_subsetAnnexName, CELLS, false); // last param: createIfMissing==false
+
+//	each face stores the subsets of all of its adjacent cells
+	index_t tupleSize = 1;
+	for(auto gt : GrobSet (FACES)) {
+		tupleSize = parallel_reduce (index_t (0), m_mesh->num (gt), tupleSize,
+		                             [&nbrhds, gt] (const index_t m, const index_t i)
+		                             {return max (m, nbrhds.num_neighbors (GrobIndex (gt, i)));},
+		                             [] (const index_t m0, const index_t m1) {return max (m0, m1);});
+	}
+
+//	writes the subsets of the cells adjacent to a face to `subsetsOut`
+	auto adjacentSubsets = [&] (const GrobIndex& face, index_t* subsetsOut) {
+		NeighborIndices nbrs = nbrhds.neighbor_indices (face);
+		for(index_t i = 0; i < tupleSize; ++i)
+			subsetsOut [i] = i < nbrs.size() ? cellSubsets [nbrs [i]] : NO_RIM_SUBSET;
+	};
+
+//	faces which are a candidate of at least one subset (see `prepare_candidates`)
+//	are copied to the pool through a counting sort. Each block of faces is
+//	processed by one thread, which counts the pool faces of its block first
+//	and then copies them to their final positions.
+	auto isPoolFace = [&] (const GrobIndex& face, index_t* subsets) {
+		adjacentSubsets (face, subsets);
+		bool isCandidate = false;
+		ForEachSingleSubset (subsets, tupleSize, [&isCandidate] (index_t) {isCandidate = true;});
+		return isCandidate;
+	};
 
-	index_t subsetIndex = 0;
-	m_subsetIndexToStageIndex.clear ();
-	for(auto mesh : m_subsetMeshes) {
+	for(auto gt : GrobSet (FACES)) {
+		const index_t numFaces = m_mesh->num (gt);
+		if (numFaces == 0)
+			continue;
+
+		const index_t numBlocks = min (numFaces, NUM_BLOCKS_PER_THREAD * ThreadPool::current().num_threads());
+		auto blockBegin = [numFaces, numBlocks] (const index_t iblock) {
+			return index_t (uint64_t (numFaces) * iblock / numBlocks);
+		};
+
+		vector <index_t> blockOffsets (numBlocks + 1, 0);
+		parallel_for (index_t (0), numBlocks, [&] (const index_t iblock) {
+			vector <index_t> subsets (tupleSize);
+			for(index_t i = blockBegin (iblock); i < blockBegin (iblock + 1); ++i) {
+				if (isPoolFace (GrobIndex (gt, i), subsets.data()))
+					++blockOffsets [iblock + 1];
+			}
+		}, 1);
 
-		m_subsetIndexToStageIndex.push_back ((int)m_renderer.num_stages());
+		for(index_t iblock = 0; iblock < numBlocks; ++iblock)
+			blockOffsets [iblock + 1] += blockOffsets [iblock];
 
-		if (mesh->has (FACES)) {
-			ComputeFaceVertexNormals3 (*mesh, "normals");
-			CreateSideGrobs (*mesh, 1);
+		const index_t numCorners = GrobDesc (gt).num_corners ();
+		const index_t* corners = m_mesh->grobs (gt).raw_ptr ();
+		GrobArray& poolFaces = m_facePool->grobs (gt);
+		poolFaces.resize (blockOffsets.back ());
+		auto& poolSubsets = *m_facePool->annex <IndexArrayAnnex> (ADJACENT_SUBSETS, gt);
+		poolSubsets.set_tuple_size (tupleSize);
+		poolSubsets.resize (blockOffsets.back () * tupleSize);
+
+		parallel_for (index_t (0), numBlocks, [&] (const index_t iblock) {
+			index_t dest = blockOffsets [iblock];
+			for(index_t i = blockBegin (iblock); i < blockBegin (iblock + 1); ++i) {
+				if (!isPoolFace (GrobIndex (gt, i), poolSubsets.raw_ptr () + dest * tupleSize))
+					continue;
+				copy (corners + i * numCorners, corners + (i + 1) * numCorners,
+				      poolFaces.raw_ptr () + dest * numCorners);
+				++dest;
+			}
+		}, 1);
+	}
+}
 
-			m_renderer.add_stage ("solid", mesh, FACES, FLAT);
-			m_renderer.stage_set_color (subset_color (subsetIndex));
+void SubsetVisualization::create_surface_face_pool ()
+{
+//	each face is adjacent to its own subset only
+	for(auto gt : GrobSet (FACES)) {
+		if (!m_mesh->has (gt))
+			continue;
+
+		const GrobArray& faces = m_mesh->grobs (gt);
+		GrobArray& poolFaces = m_facePool->grobs (gt);
+		poolFaces.resize (faces.size ());
+		copy (faces.raw_ptr (), faces.raw_ptr () + faces.num_indices (), poolFaces.raw_ptr ());
+
+		const IndexArrayAnnex& subsets = *m_mesh->annex <IndexArrayAnnex> (m_subsetAnnexName, gt);
+		auto& poolSubsets = *m_facePool->annex <IndexArrayAnnex> (ADJACENT_SUBSETS, gt);
+		poolSubsets.set_tuple_size (1);
+		poolSubsets.resize (subsets.size ());
+		copy (subsets.begin (), subsets.end (), poolSubsets.begin ());
+	}
+}
 
-			m_renderer.add_stage ("wire", mesh, EDGES, FLAT);
-			m_renderer.stage_set_color (wireColor);
+void SubsetVisualization::create_face_pool_edges ()
+{
+//	the edges of all faces in the pool are created in one parallel pass. The
+//	edges of a subset are then found through the edge indices of its faces.
+	IndexArrayAnnex sideInds;
+	if (m_facePool->has (FACES))
+		CreateSideGrobs (*m_facePool, FACES, 1, &sideInds);
+
+	index_t firstSide = 0;
+	for(auto gt : GrobSet (FACES)) {
+		if (!m_facePool->has (gt))
+			continue;
+
+		const index_t numSides = GrobDesc (gt).num_sides (1);
+		auto& faceEdges = *m_facePool->annex <IndexArrayAnnex> (FACE_EDGES, gt);
+		faceEdges.set_tuple_size (numSides);
+		faceEdges.resize (m_facePool->num (gt) * numSides);
+
+	//	sideInds holds pairs of (side type, side index)
+		const index_t* sides = sideInds.raw_ptr () + 2 * firstSide;
+		index_t* edges = faceEdges.raw_ptr ();
+		parallel_for (index_t (0), index_t (faceEdges.size ()), [sides, edges] (const index_t i) {
+			edges [i] = sides [2 * i + 1];
+		});
+		firstSide += index_t (faceEdges.size ());
+	}
+}
+
+void SubsetVisualization::prepare_candidates ()
+{
+	const PoolFaceTuples adjacent (*m_facePool, ADJACENT_SUBSETS);
+	const index_t numFaces = m_facePool->num (FACES);
+
+	int maxSI = -1;
+	for(auto gt : GrobSet (FACES)) {
+		auto psubsets = m_facePool->optional_annex <IndexArrayAnnex> (ADJACENT_SUBSETS, gt);
+		if (!psubsets)
+			continue;
+		maxSI = parallel_reduce (psubsets->begin(), psubsets->end(), maxSI,
+		                         [] (const int m, const index_t si)
+		                         {return si == NO_RIM_SUBSET ? m : max (m, int (si));},
+		                         [] (const int m0, const int m1) {return max (m0, m1);});
+	}
+	m_numSubsets = index_t (maxSI + 1);
+	const index_t numSubsets = m_numSubsets;
+
+	m_candidateOffsets.assign (numSubsets + 1, 0);
+	m_candidates.clear ();
+	if (numFaces == 0 || numSubsets == 0)
+		return;
+
+//	candidates are sorted by subset through a counting sort. Each block of faces
+//	is processed by one thread, which counts the candidates of each subset in
+//	its block first and then writes them to their final positions.
+	const index_t numBlocks = min (numFaces, NUM_BLOCKS_PER_THREAD * ThreadPool::current().num_threads());
+	auto blockBegin = [numFaces, numBlocks] (const index_t iblock) {
+		return index_t (uint64_t (numFaces) * iblock / numBlocks);
+	};
+
+//	blockOffsets [iblock * numSubsets + si] counts the candidates of subset si in block iblock
+	vector <index_t> blockOffsets (numBlocks * numSubsets, 0);
+	parallel_for (index_t (0), numBlocks, [&] (const index_t iblock) {
+		index_t* counts = blockOffsets.data() + iblock * numSubsets;
+		for(index_t fi = blockBegin (iblock); fi < blockBegin (iblock + 1); ++fi)
+			ForEachSingleSubset (adjacent [fi], adjacent.tuple_size (fi), [counts] (const index_t si) {++counts [si];});
+	}, 1);
+
+//	convert counts to offsets into the candidate array
+	index_t offset = 0;
+	for(index_t si = 0; si < numSubsets; ++si) {
+		m_candidateOffsets [si] = offset;
+		for(index_t iblock = 0; iblock < numBlocks; ++iblock) {
+			const index_t c = blockOffsets [iblock * numSubsets + si];
+			blockOffsets [iblock * numSubsets + si] = offset;
+			offset += c;
+		}
+	}
+	m_candidateOffsets [numSubsets] = offset;
+
+	m_candidates.resize (offset);
+	parallel_for (index_t (0), numBlocks, [&] (const index_t iblock) {
+		index_t* offsets = blockOffsets.data() + iblock * numSubsets;
+		for(index_t fi = blockBegin (iblock); fi < blockBegin (iblock + 1); ++fi) {
+			ForEachSingleSubset (adjacent [fi], adjacent.tuple_size (fi), [this, offsets, fi] (const index_t si)
+				{m_candidates [offsets [si]++] = fi;});
 		}
-		++subsetIndex;
+	}, 1);
+}
+
+void SubsetVisualization::refresh_face_subsets ()
+{
+//	the faces of a surface mesh are written to the range of their own subset,
+//	independent of the visibility of that subset.
+	const PoolFaceTuples adjacent (*m_facePool, ADJACENT_SUBSETS);
+	const bool isRim = m_mesh->grob_set_type_of_highest_dim () == CELLS;
+
+	m_faceSubsets.resize (m_facePool->num (FACES));
+	parallel_for (index_t (0), index_t (m_faceSubsets.size()), [&] (const index_t fi) {
+		m_faceSubsets [fi] = isRim ? rim_subset (adjacent [fi], adjacent.tuple_size (fi)) : adjacent [fi][0];
+	});
+}
+
+void SubsetVisualization::
+collect_subset_faces (const index_t si, vector <index_t>& facesOut) const
+{
+	facesOut.clear ();
+	for(index_t i = m_candidateOffsets [si]; i < m_candidateOffsets [si + 1]; ++i) {
+		const index_t fi = m_candidates [i];
+		if (m_faceSubsets [fi] == si)
+			facesOut.push_back (fi);
+	}
+}
+
+void SubsetVisualization::
+collect_grobs (const index_t* faces, const index_t numFaces, SubsetGrobs& grobsOut) const
+{
+	for(auto gt : BATCH_GROB_TYPES)
+		grobsOut.corners [gt].clear ();
+
+	const PoolFaceTuples faceEdges (*m_facePool, FACE_EDGES);
+	vector <index_t> edgeInds;
+	for(index_t i = 0; i < numFaces; ++i) {
+		const Grob f = face (faces [i]);
+		vector <index_t>& corners = grobsOut.corners [f.grob_type ()];
+		for(index_t j = 0; j < f.num_corners (); ++j)
+			corners.push_back (f.corner (j));
+
+		const index_t* edges = faceEdges [faces [i]];
+		edgeInds.insert (edgeInds.end(), edges, edges + faceEdges.tuple_size (faces [i]));
+	}
+
+	sort (edgeInds.begin(), edgeInds.end());
+	edgeInds.erase (unique (edgeInds.begin(), edgeInds.end()), edgeInds.end());
+
+	const index_t* edgeCorners = m_facePool->grobs (EDGE).raw_ptr ();
+	vector <index_t>& corners = grobsOut.corners [EDGE];
+	corners.resize (edgeInds.size() * 2);
+	for(size_t i = 0; i < edgeInds.size(); ++i) {
+		corners [2 * i] = edgeCorners [2 * edgeInds [i]];
+		corners [2 * i + 1] = edgeCorners [2 * edgeInds [i] + 1];
+	}
+}
+
+void SubsetVisualization::create_batch_mesh ()
+{
+//	all subsets are merged into a single batch mesh, so that they can be
+//	drawn with one draw call. The subset of each face and edge is stored in an
+//	annex and is used by the renderer to look up color and visibility of each
+//	primitive. Edges on the border of several subsets are listed once for each
+//	of those subsets on purpose: each primitive carries a single subset, so that
+//	the renderer can hide it and so that the range of a subset can be rewritten
+//	in-place without touching the ranges of its neighbors.
+	if (!m_batchMesh)
+		m_batchMesh = make_shared <Mesh> ();
+	m_batchMesh->clear_grobs ();
+	m_batchMesh->set_coords (m_mesh->coords());
+	m_batchNormalSums.clear ();
+
+	const index_t numSubsets = m_numSubsets;
+	vector <index_t> allSubsets (numSubsets);
+	for(index_t si = 0; si < numSubsets; ++si)
+		allSubsets [si] = si;
+
+//	The rim of a subset can only consist of its candidate faces. The ranges of
+//	volume meshes can hold all of them, so that they can be updated in-place if
+//	the rim changes. For surface meshes the candidates are the faces themselves.
+	const bool isRim = m_mesh->grob_set_type_of_highest_dim () == CELLS;
+	vector <SubsetGrobs> subsetGrobs (numSubsets);
+	vector <index_t> capacities [NUM_GROB_TYPES];
+	for(auto gt : BATCH_GROB_TYPES)
+		capacities [gt].resize (numSubsets);
+
+	ParallelForEachSubset (allSubsets,
+		[this] (const index_t si) {return num_candidates (si);},
+		[&] (const index_t si) {
+			vector <index_t> faces;
+			collect_subset_faces (si, faces);
+			collect_grobs (faces.data(), index_t (faces.size()), subsetGrobs [si]);
+
+			if (isRim) {
+				SubsetGrobs candidates;
+				collect_grobs (m_candidates.data() + m_candidateOffsets [si],
+				               num_candidates (si), candidates);
+				for(auto gt : BATCH_GROB_TYPES)
+					capacities [gt][si] = candidates.num (gt);
+			}
+			else {
+				for(auto gt : BATCH_GROB_TYPES)
+					capacities [gt][si] = subsetGrobs [si].num (gt);
+			}
+		});
+
+	for(auto gt : BATCH_GROB_TYPES) {
+		BatchRanges& ranges = m_batchRanges [gt];
+		ranges.offsets.assign (numSubsets + 1, 0);
+		for(index_t si = 0; si < numSubsets; ++si)
+			ranges.offsets [si + 1] = ranges.offsets [si] + capacities [gt][si];
+	//	all slots are initialized by `write_batch_range`
+		ranges.sizes = std::move (capacities [gt]);
+
+		m_batchMesh->grobs (gt).resize (ranges.offsets.back());
+
+		auto& subsets = *m_batchMesh->annex <IndexArrayAnnex> (m_subsetAnnexName, gt);
+		subsets.resize (ranges.offsets.back());
+		for(index_t si = 0; si < numSubsets; ++si)
+			fill (subsets.begin() + ranges.offsets [si], subsets.begin() + ranges.offsets [si + 1], si);
 	}
+
+	ParallelForEachSubset (std::move (allSubsets),
+		[this] (const index_t si) {return num_candidates (si);},
+		[&] (const index_t si) {
+			for(auto gt : BATCH_GROB_TYPES) {
+				write_batch_range (gt, si, subsetGrobs [si].corners [gt].data(),
+				                   subsetGrobs [si].num (gt));
+			}
+		});
+
+	if (!m_batchMesh->has (FACES))
+		return;
+
+	ComputeFaceVertexNormals3 (*m_batchMesh, "normals");
+}
+
+bool SubsetVisualization::
+write_batch_range (const grob_t grobType,
+                   const index_t si,
+                   const index_t* corners,
+                   const index_t numGrobs)
+{
+	BatchRanges& ranges = m_batchRanges [grobType];
+	const index_t first = ranges.offsets [si];
+	const index_t capacity = ranges.offsets [si + 1] - first;
+	if (numGrobs > capacity)
+		return false;
+
+	const index_t numCorners = GrobDesc (grobType).num_corners ();
+	index_t* dest = m_batchMesh->grobs (grobType).raw_ptr () + first * numCorners;
+	copy (corners, corners + numGrobs * numCorners, dest);
+
+//	slots which were used before are filled with degenerate grobs, which aren't rasterized
+	fill (dest + numGrobs * numCorners,
+	      dest + max (numGrobs, ranges.sizes [si]) * numCorners,
+	      index_t (0));
+
+	ranges.sizes [si] = numGrobs;
+	return true;
+}
+
+bool SubsetVisualization::update_batch_mesh (const vector <index_t>& changedSubsets)
+{
+//	new subsets require new ranges
+	if (!m_batchMesh
+	    || m_batchRanges [EDGE].offsets.size() != m_numSubsets + 1
+	    || !m_batchMesh->has_annex <RealArrayAnnex> ("normals", VERTEX))
+	{
+		return false;
+	}
+
+	const index_t numChanged = index_t (changedSubsets.size());
+	vector <SubsetGrobs> newGrobs (numChanged);
+	parallel_for (index_t (0), numChanged, [&] (const index_t i) {
+		vector <index_t> faces;
+		collect_subset_faces (changedSubsets [i], faces);
+		collect_grobs (faces.data(), index_t (faces.size()), newGrobs [i]);
+	}, 1);
+
+//	the batch mesh is only changed if the new grobs fit into the existing ranges
+	for(index_t i = 0; i < numChanged; ++i) {
+		const index_t si = changedSubsets [i];
+		for(auto gt : BATCH_GROB_TYPES) {
+			if (newGrobs [i].num (gt) > m_batchRanges [gt].offsets [si + 1] - m_batchRanges [gt].offsets [si])
+				return false;
+		}
+	}
+
+	const real_t* coords = m_batchMesh->coords()->raw_ptr ();
+	if (m_batchNormalSums.empty ()) {
+		m_batchNormalSums.assign (m_batchMesh->num_coords (), 0);
+		for(auto gt : GrobSet (FACES)) {
+			const GrobArray& faces = m_batchMesh->grobs (gt);
+			AccumulateFaceNormals (m_batchNormalSums, coords, faces.raw_ptr (),
+			                       faces.size (), GrobDesc (gt).num_corners (), 1);
+		}
+	}
+
+//	the normals of all corners of removed and inserted faces have to be updated
+	vector <index_t> touchedVrts;
+	for(index_t i = 0; i < numChanged; ++i) {
+		const index_t si = changedSubsets [i];
+		for(auto gt : GrobSet (FACES)) {
+			const index_t numCorners = GrobDesc (gt).num_corners ();
+			const index_t* oldFaces = m_batchMesh->grobs (gt).raw_ptr ()
+			                          + m_batchRanges [gt].offsets [si] * numCorners;
+			const index_t numOld = m_batchRanges [gt].sizes [si];
+			touchedVrts.insert (touchedVrts.end(), oldFaces, oldFaces + numOld * numCorners);
+			AccumulateFaceNormals (m_batchNormalSums, coords, oldFaces, numOld, numCorners, -1);
+
+			const vector <index_t>& newFaces = newGrobs [i].corners [gt];
+			touchedVrts.insert (touchedVrts.end(), newFaces.begin(), newFaces.end());
+			AccumulateFaceNormals (m_batchNormalSums, coords, newFaces.data (),
+			                       newGrobs [i].num (gt), numCorners, 1);
+		}
+
+		for(auto gt : BATCH_GROB_TYPES)
+			write_batch_range (gt, si, newGrobs [i].corners [gt].data (), newGrobs [i].num (gt));
+	}
+
+	sort (touchedVrts.begin(), touchedVrts.end());
+	touchedVrts.erase (unique (touchedVrts.begin(), touchedVrts.end()), touchedVrts.end());
+
+	real_t* normals = m_batchMesh->annex <RealArrayAnnex> ("normals", VERTEX)->raw_ptr ();
+	for(auto vrt : touchedVrts)
+		VecNormalize (normals + vrt * 3, 3, m_batchNormalSums.data() + vrt * 3);
+
+	return true;
+}
+
+void SubsetVisualization::prepare_renderer ()
+{
+	m_renderer.clear ();
+	m_rendererOutdated = false;
+
+	if (!m_subsetInfo)
+		return;
+
+	const glm::vec4 wireColor (0.2f, 0.2f, 0.2f, 1.0f);
+
+	const index_t numSubsets = m_numSubsets;
+	vector <glm::vec4> subsetColors;
+	subsetColors.reserve (numSubsets);
+	for(index_t si = 0; si < numSubsets; ++si)
+		subsetColors.push_back (subset_color (si));
+
+	m_renderer.set_subset_colors (std::move (subsetColors));
+	for(index_t si = 0; si < numSubsets; ++si)
+		m_renderer.set_subset_visible (si, subset_visible (si));
+
+	if (!m_batchMesh || !m_batchMesh->has (FACES))
+		return;
+
+//	the batch mesh is reused, so buffers created from earlier contents are outdated
+	GLResourceCache::invalidate (m_batchMesh.get());
+	GLResourceCache::invalidate (m_batchMesh->annex<RealArrayAnnex>("normals", VERTEX).get());
+
+//	see SOLID_STAGE and WIRE_STAGE
+	m_renderer.add_stage ("solid", m_batchMesh, FACES, FLAT);
+	m_renderer.stage_set_subset_annex (m_subsetAnnexName);
+
+	m_renderer.add_stage ("wire", m_batchMesh, EDGES, FLAT);
+	m_renderer.stage_set_color (wireColor);
+	m_renderer.stage_set_subset_annex (m_subsetAnnexName);
 }
 
 void SubsetVisualization::refresh_subset_info_annex_name ()
@@ -148,8 +930,14 @@ void SubsetVisualization::refresh_subset_info_annex_name ()
 
 void SubsetVisualization::render (const View& view)
 {
-	if (m_refreshRequired)
-		refresh ();
+	if (!m_pendingVisibilityChanges.empty ()) {
+		update_cell_rim (std::move (m_pendingVisibilityChanges));
+		m_pendingVisibilityChanges.clear ();
+	}
+
+	if (m_rendererOutdated)
+		prepare_renderer ();
+
 	m_renderer.render (view);
 }
 
@@ -161,75 +949,97 @@ glm::vec2 SubsetVisualization::estimate_z_clip_dists (const View& view) const
 }
 
 
-void SubsetVisualization::
-subset_meshes_from_grobs (SPMesh mesh, const GrobSet grobSet, bool ignoreSubsetVisibilities)
+void SubsetVisualization::update_cell_rim (std::vector <index_t> toggledSubsets)
 {
-//	reuse subset meshes to avoid reallocations
-	for (auto& m : m_subsetMeshes)
-		m->clear_grobs ();
+	if (!m_facePool) {
+		create_face_pool (CELLS);
+		create_batch_mesh ();
+		m_rendererOutdated = true;
+		return;
+	}
 
-	int maxSI = -1;
+//	only candidate faces of the toggled subsets may change their state.
+//	The ranges of their old and new rim subsets have to be rewritten.
+	sort (toggledSubsets.begin(), toggledSubsets.end());
+	toggledSubsets.erase (unique (toggledSubsets.begin(), toggledSubsets.end()),
+	                      toggledSubsets.end());
 
-	for(auto grobType : grobSet) {
-		auto pinds = mesh->optional_annex <IndexArrayAnnex> (m_subsetAnnexName, grobType);
-		if (!pinds)
+	const PoolFaceTuples adjacent (*m_facePool, ADJACENT_SUBSETS);
+	vector <index_t> changedSubsets;
+	for(auto si : toggledSubsets) {
+		if (si >= m_numSubsets)
 			continue;
 
-		auto& inds = *pinds;
-		COND_THROW (inds.size () != mesh->num (grobType),
-		            "IndexArrayAnnex of subset indices has wrong size: " << inds.size()
-		            << " expected: " << mesh->num (grobType) << ")");
-
-		index_t counter = 0;
-		for(auto grob : mesh->grobs (grobType)) {
-			const index_t si = inds [counter];
-			maxSI = max (maxSI, (int)si);
-			if (ignoreSubsetVisibilities || m_subsetInfo->subset_properties (si).visible)
-				subset_mesh (si).insert (grob);
-			++counter;
+		for(index_t i = m_candidateOffsets [si]; i < m_candidateOffsets [si + 1]; ++i) {
+			const index_t fi = m_candidates [i];
+			const index_t oldSI = m_faceSubsets [fi];
+			const index_t newSI = rim_subset (adjacent [fi], adjacent.tuple_size (fi));
+			if (oldSI != newSI) {
+				m_faceSubsets [fi] = newSI;
+				if (oldSI != NO_RIM_SUBSET)
+					changedSubsets.push_back (oldSI);
+				if (newSI != NO_RIM_SUBSET)
+					changedSubsets.push_back (newSI);
+			}
 		}
 	}
 
-//	make sure that all subset meshes exist
-//	first add missing subset meshes (e.g. if the last subset is not visible)
-	for(int i = (int)m_subsetMeshes.size(); i <= maxSI; ++i)
-		subset_mesh (i);
-//	now remove subsets which were not required (e.g. because the number of subsets decreased)
-	m_subsetMeshes.resize (maxSI + 1);
-}
+	sort (changedSubsets.begin(), changedSubsets.end());
+	changedSubsets.erase (unique (changedSubsets.begin(), changedSubsets.end()),
+	                      changedSubsets.end());
 
+	for(auto si : toggledSubsets)
+		m_renderer.set_subset_visible (si, subset_visible (si));
 
-void SubsetVisualization::subset_meshes_from_cell_rim ()
-{
-	if (!m_rimMesh)
-		m_rimMesh = make_shared <Mesh> ();
-	m_rimMesh->clear_grobs ();
-	m_rimMesh->set_annex (m_subsetAnnexName, NO_GROB, m_subsetInfo);
+	if (changedSubsets.empty ())
+		return;
 
-	//	extract the rim of the visible elements
-	auto srcSubset = ArrayAnnexTable <IndexArrayAnnex> (m_mesh, m_subsetAnnexName, CELLS, false); // last param: createIfMissing==false
-	auto rimSubset = ArrayAnnexTable <IndexArrayAnnex> (m_rimMesh, m_subsetAnnexName, FACES, true); // last param: createIfMissing==true
-	rimSubset.clear_arrays ();
+//	Only the grobs and normals of the batch mesh change if it is updated
+//	in-place. Coordinates and subsets of the primitives are kept.
+	if (!update_batch_mesh (changedSubsets)) {
+		create_batch_mesh ();
+		m_rendererOutdated = true;
+	}
+	else if (m_renderer.num_stages () == 0)
+		m_rendererOutdated = true;
+	else if (!m_rendererOutdated) {
+		m_renderer.invalidate_stage_grobs (SOLID_STAGE);
+		m_renderer.invalidate_stage_grobs (WIRE_STAGE);
+		m_renderer.invalidate_stage_normals (WIRE_STAGE);
+	}
+}
 
-	auto isVisible = [subsetInfo=m_subsetInfo, &srcSubset] (const GrobIndex& srcGrob)
-				 	 {return subsetInfo->subset_properties (srcSubset[srcGrob]).visible;};
 
-	auto gotRimElem = [&rimSubset, &srcSubset] (const GrobIndex& rimGrob, const GrobIndex& srcGrob)
-					  {rimSubset.annex(rimGrob.grobType)->push_back (srcSubset[srcGrob]);};
+index_t SubsetVisualization::
+rim_subset (const index_t* adjacentSubsets, const index_t numAdjacent) const
+{
+//	a face belongs to the rim of the visible cells if exactly one of its
+//	adjacent cells is visible (see lume::CreateRimMesh).
+	index_t numVis = 0;
+	index_t visSI = NO_RIM_SUBSET;
+	for(index_t i = 0; i < numAdjacent; ++i) {
+		const index_t si = adjacentSubsets [i];
+		if (si != NO_RIM_SUBSET && subset_visible (si)) {
+			visSI = si;
+			++numVis;
+		}
+	}
+	return numVis == 1 ? visSI : NO_RIM_SUBSET;
+}
 
-	CreateRimMesh (m_rimMesh, m_mesh, CELLS, isVisible, gotRimElem, &m_neighborhoods);
 
-	subset_meshes_from_grobs (m_rimMesh, FACES, true);
+Grob SubsetVisualization::face (const index_t fi) const
+{
+	const index_t numTris = m_facePool->num (TRI);
+	if (fi < numTris)
+		return m_facePool->grob (GrobIndex (TRI, fi));
+	return m_facePool->grob (GrobIndex (QUAD, fi - numTris));
 }
 
 
-Mesh& SubsetVisualization::subset_mesh (const index_t si)
+index_t SubsetVisualization::num_candidates (const index_t si) const
 {
-	while (si >= m_subsetMeshes.size()) {
-		m_subsetMeshes.push_back (make_shared<Mesh>());
-		m_subsetMeshes.back()->set_coords (m_mesh->coords());
-	}
-	return *m_subsetMeshes[si];
+	return m_candidateOffsets [si + 1] - m_candidateOffsets [si];
 }
 
 
@@ -246,11 +1056,17 @@ receive_message (const Message& msg)
 
 		if (simsg->color_changed ()){
 			const index_t si = simsg->subset_index();
-			const int stageIndex = m_subsetIndexToStageIndex[si];
-			m_renderer.stage_set_color (subset_color (si), stageIndex);
+			m_renderer.set_subset_color (si, subset_color (si));
+		}
+		if (simsg->visibility_changed ()) {
+		//	only the rim of volume meshes has to be updated
+			if (m_mesh->grob_set_type_of_highest_dim () == CELLS)
+				m_pendingVisibilityChanges.push_back (simsg->subset_index());
+			else {
+				const index_t si = simsg->subset_index();
+				m_renderer.set_subset_visible (si, subset_visible (si));
+			}
 		}
-		if (simsg->visibility_changed ())
-			m_refreshRequired = true;
 	}
 }
 
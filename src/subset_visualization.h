@@ -27,8 +27,10 @@
 #ifndef __H__lumeview_subset_visualization
 #define __H__lumeview_subset_visualization
 
+#include <cstdint>
+#include <string>
+#include "lume/annex_table.h"
 #include "lume/mesh.h"
-#include "lume/neighborhoods.h"
 
 #include "lumeview_error.h"
 #include "message_receiver.h"
@@ -48,10 +50,33 @@ class SubsetVisualization : public Visualization, public MessageReceiver
 {
 public:
 	SubsetVisualization ();
-	SubsetVisualization (lume::SPMesh mesh);
+
+	/// \param cacheFilename	(optional) see `set_cache_filename`
+	/// \param progress		(optional) receives the phases of the initial `refresh`.
+	///						Returning false cancels the construction through a
+	///						`lume::LoadCancelledError`.
+	SubsetVisualization (lume::SPMesh mesh,
+	                     std::string cacheFilename = std::string (),
+	                     const lume::LoadProgressCallback& progress = lume::LoadProgressCallback ());
 	
 	void set_mesh (lume::SPMesh mesh);
 
+	/// Sets the sidecar file in which derived data is cached (see visualization_cache.h)
+	/** The merged subset meshes including their edges and normals are loaded
+	 * from this file during `refresh`, if they were stored for the same mesh
+	 * contents and subset visibilities. Otherwise they are recreated and stored.
+	 * For volume meshes, the faces from which the rim is assembled are cached
+	 * in a second file with the suffix ".rim", independent of the subset
+	 * visibilities. If both are found, neither neighborhoods nor faces of the
+	 * mesh are created. Later visibility changes still update the batch mesh
+	 * in-place.
+	 * Caching is disabled for an empty filename.*/
+	void set_cache_filename (std::string cacheFilename);
+
+	/// Recreates the data which is displayed
+	/** Doesn't access OpenGL. The stages of the renderer are recreated during
+	 * the next call to `render`. A visualization may thus be created on a
+	 * thread other than the rendering thread.*/
 	void refresh ();
 
 	void render (const View& view) override;
@@ -61,29 +86,80 @@ public:
 	void receive_message (const Message& msg) override;
 
 private:
-	void create_subset_meshes (const lume::GrobSet grobSet);
+	struct SubsetGrobs;
+
+	void create_face_pool (const lume::GrobSet grobSet);
+	void create_rim_face_pool ();
+	void create_surface_face_pool ();
+	void create_face_pool_edges ();
+	void prepare_candidates ();
+	void refresh_face_subsets ();
+	void create_batch_mesh ();
+	bool update_batch_mesh (const std::vector <index_t>& changedSubsets);
+	bool write_batch_range (const lume::grob_t grobType,
+	                        const index_t si,
+	                        const index_t* corners,
+	                        const index_t numGrobs);
+	bool load_cached_batch_mesh (const uint64_t cacheKey);
+	bool load_cached_face_pool (const uint64_t cacheKey);
+	uint64_t batch_mesh_cache_key ();
+	uint64_t face_pool_cache_key ();
+	uint64_t mesh_hash ();
 	void prepare_renderer ();
-	void subset_meshes_from_grobs (lume::SPMesh mesh,
-	                               const lume::GrobSet grobSet,
-	                               bool ignoreSubsetVisibilities);
-	void subset_meshes_from_cell_rim ();
+	void update_cell_rim (std::vector <index_t> toggledSubsets);
+	void collect_subset_faces (const index_t si, std::vector <index_t>& facesOut) const;
+	void collect_grobs (const index_t* faces, const index_t numFaces, SubsetGrobs& grobsOut) const;
+	index_t rim_subset (const index_t* adjacentSubsets, const index_t numAdjacent) const;
+	lume::Grob face (const index_t fi) const;
+	index_t num_candidates (const index_t si) const;
 	void refresh_subset_info_annex_name ();
-	lume::Mesh& subset_mesh (const index_t si);
 	
 	glm::vec4 subset_color (const index_t si) const;
 	bool subset_visible (const index_t si) const;
 
 	Renderer					m_renderer;
-	lume::Neighborhoods			m_neighborhoods;
 	lume::SPMesh				m_mesh;
 	std::shared_ptr<lume::SubsetInfoAnnex>		m_subsetInfo;
-	lume::SPMesh				m_rimMesh;
-	std::vector <lume::SPMesh>	m_subsetMeshes;
+	lume::SPMesh				m_batchMesh;
+
+//	layout of the batch mesh. For each grob type, the grobs of each subset are
+//	stored in a contiguous range of slots. Unused slots at the end of a range
+//	hold degenerate grobs, so that the ranges of volume meshes can be updated
+//	in-place if the rim changes (see `update_batch_mesh`).
+	struct BatchRanges {
+		std::vector <index_t>	offsets;	///< first slot of each subset, CSR layout
+		std::vector <index_t>	sizes;		///< number of used slots of each subset
+	};
+	BatchRanges					m_batchRanges [lume::NUM_GROB_TYPES];
+//	unnormalized sum of the adjacent face normals of each vertex of the batch
+//	mesh. Only created if the batch mesh is updated in-place.
+	std::vector <real_t>		m_batchNormalSums;
 	std::string					m_subsetAnnexName;
-	std::vector <int>			m_subsetIndexToStageIndex;
+	std::string					m_cacheFilename;
+//	only set during construction, see the constructor
+	lume::LoadProgressCallback	m_progress;
+	uint64_t					m_meshHash;
+	bool						m_meshHashValid;
+
+//	pool of the faces from which the batch mesh is assembled. Faces are indexed
+//	consecutively, triangles first (see `face`). For volume meshes the pool
+//	holds the faces which may be part of the rim of the visible cells, for
+//	surface meshes it holds all faces. The `ADJACENT_SUBSETS` annex of the pool
+//	stores for each face the subsets of its adjacent cells (or of the face
+//	itself for surface meshes).
+//	A face is a candidate of a subset if exactly one of its adjacent subsets
+//	equals that subset. `m_candidates` holds the candidates of each subset in
+//	CSR layout. For each face, `m_faceSubsets` stores the subset into whose
+//	range of the batch mesh it is written, or `NO_RIM_SUBSET`.
+	lume::SPMesh				m_facePool;
+	index_t						m_numSubsets;
+	std::vector <index_t>		m_candidateOffsets;
+	std::vector <index_t>		m_candidates;
+	std::vector <index_t>		m_faceSubsets;
+	std::vector <index_t>		m_pendingVisibilityChanges;
 
 	const void*					m_subject;
-	bool						m_refreshRequired;
+	bool						m_rendererOutdated;
 };
 
 }//	end of namespace lumeview
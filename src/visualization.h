@@ -27,6 +27,7 @@
 #ifndef __H__lumeview_visualization
 #define __H__lumeview_visualization
 
+#include "lume/file_io.h"
 #include "view.h"
 
 namespace lumeview {
@@ -41,6 +42,15 @@ public:
 
 using SPVisualization = std::shared_ptr <Visualization>;
 
+/// passes the current phase of the creation of a visualization to an optional callback
+/** Throws a `lume::LoadCancelledError` if the callback requests cancellation.*/
+inline void ReportVisualizationProgress (const lume::LoadProgressCallback& progress,
+                                         const char* phase)
+{
+	if (progress && !progress (phase, 0, 0))
+		throw lume::LoadCancelledError (std::string ("Loading was cancelled while ").append (phase));
+}
+
 }//	end of namespace lumeview
 
 #endif	//__H__lumeview_visualization
@@ -0,0 +1,120 @@
+// This file is part of lumeview, a lightweight viewer for unstructured meshes
+//
+// Copyright (C) 2018 Sebastian Reiter
+// Copyright (C) 2018 G-CSC, Goethe University Frankfurt
+// Author: Sebastian Reiter <s.b.reiter@gmail.com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <cstring>
+#include "visualization_cache.h"
+#include "lume/binary_mesh_file.h"
+#include "lume/file_io.h"
+#include "lume/parallel_algorithms.h"
+
+using namespace std;
+using namespace lume;
+
+namespace lumeview {
+
+const char* const VISUALIZATION_CACHE_SUFFIX = ".lumevis";
+
+/// checks whether grobs and vertex annexes of `mesh` are consistent with the given number of vertices
+/** Derived meshes are stored without coordinates, so that these checks can't
+ * be performed by `lume::CreateMeshFromBinaryFile`.*/
+static bool MatchesVertices (const Mesh& mesh, const index_t numVrts)
+{
+	for(index_t i = 0; i < NUM_GROB_TYPES; ++i) {
+		const grob_t grobType = grob_t (i);
+		if (grobType == VERTEX || !mesh.has (grobType))
+			continue;
+
+		const GrobArray& grobs = mesh.grobs (grobType);
+		const index_t* corners = grobs.raw_ptr ();
+		const index_t maxCorner = parallel_reduce (corners, corners + grobs.num_indices (), index_t (0),
+		                            [] (const index_t m, const index_t c) {return max (m, c);},
+		                            [] (const index_t a, const index_t b) {return max (a, b);});
+		if (maxCorner >= numVrts)
+			return false;
+	}
+
+//	the coordinates aren't stored and are replaced by those of the visualized mesh
+	for(auto iannex = mesh.annex_begin(); iannex != mesh.annex_end(); ++iannex) {
+		if (iannex->first.grobType != VERTEX || iannex->first.name == "coords")
+			continue;
+		if (auto a = dynamic_cast <const RealArrayAnnex*> (iannex->second.get())) {
+			if (a->num_tuples () != numVrts)
+				return false;
+		}
+		else if (auto a = dynamic_cast <const IndexArrayAnnex*> (iannex->second.get())) {
+			if (a->num_tuples () != numVrts)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+uint64_t VisualizationCacheKey (const char* tag,
+                                const uint64_t meshHash,
+                                const void* state,
+                                const size_t stateSize)
+{
+	const uint64_t tagHash = HashBytes (tag, strlen (tag), meshHash);
+	return HashBytes (state, stateSize, tagHash);
+}
+
+
+void StoreVisualizationCache (const std::string& filename,
+                              const uint64_t key,
+                              const lume::Mesh& derivedMesh)
+{
+	FileStamp stamp;
+	stamp.contentHash = key;
+	try {
+		WriteBinaryMeshFile (derivedMesh, filename, stamp, false);
+	}
+	catch (FileIOError&) {}
+}
+
+
+lume::SPMesh LoadVisualizationCache (const std::string& filename,
+                                     const uint64_t key,
+                                     const lume::SPRealArrayAnnex& coords)
+{
+	try {
+		if (ReadBinaryMeshFileStamp (filename).contentHash != key)
+			return SPMesh ();
+
+		auto mesh = CreateMeshFromBinaryFile (filename);
+		if (!coords || !MatchesVertices (*mesh, coords->num_tuples ()))
+			return SPMesh ();
+
+		mesh->set_coords (coords);
+		return mesh;
+	}
+	catch (FileIOError&) {
+		return SPMesh ();
+	}
+}
+
+}//	end of namespace lumeview
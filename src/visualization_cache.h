@@ -0,0 +1,68 @@
+// This file is part of lumeview, a lightweight viewer for unstructured meshes
+//
+// Copyright (C) 2018 Sebastian Reiter
+// Copyright (C) 2018 G-CSC, Goethe University Frankfurt
+// Author: Sebastian Reiter <s.b.reiter@gmail.com>
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+// THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __H__lumeview_visualization_cache
+#define __H__lumeview_visualization_cache
+
+#include <cstdint>
+#include <string>
+#include "lume/mesh.h"
+
+namespace lumeview {
+
+/// suffix which is appended to the name of a mesh file to obtain the name of its visualization cache
+extern const char* const VISUALIZATION_CACHE_SUFFIX;
+
+/// Creates a key which identifies data derived from a mesh
+/** \param tag		name and version of the derived data. Has to be changed
+ *					whenever the way in which the data is derived changes.
+ * \param meshHash	hash of the contents of the source mesh, see `lume::HashMeshContents`.
+ * \param state		(optional) further parameters on which the derived data depends.*/
+uint64_t VisualizationCacheKey (const char* tag,
+                                const uint64_t meshHash,
+                                const void* state = nullptr,
+                                const size_t stateSize = 0);
+
+/// Stores a mesh derived from a visualized mesh in a sidecar file
+/** The mesh is written in the lume binary mesh format together with `key`.
+ * Coordinates are not written, since derived meshes share the coordinates
+ * of the visualized mesh. The cache is optional, failures to write it are
+ * thus ignored.*/
+void StoreVisualizationCache (const std::string& filename,
+                              const uint64_t key,
+                              const lume::Mesh& derivedMesh);
+
+/// Loads a derived mesh from a sidecar file if it was stored with the same key
+/** Returns an empty pointer if the file doesn't exist, is invalid, was
+ * stored with a different key, or references vertices which `coords` doesn't
+ * provide. The returned mesh uses the given coordinates.*/
+lume::SPMesh LoadVisualizationCache (const std::string& filename,
+                                     const uint64_t key,
+                                     const lume::SPRealArrayAnnex& coords);
+
+}//	end of namespace lumeview
+
+#endif	//__H__lumeview_visualization_cache